@@ -0,0 +1,143 @@
+//
+// This file is part of an OMNeT++/OMNEST simulation example.
+//
+// Copyright (C) 1992-2015 Andras Varga
+//
+// This file is distributed WITHOUT ANY WARRANTY. See the file
+// `license' for details on this and other legal matters.
+//
+
+#include <algorithm>
+#include <cmath>
+
+#include "DataGathering.h"
+
+using namespace std;
+
+namespace aloha {
+
+DataGathering::DataGathering(const std::vector<int>& parent, const std::vector<double>& energyPerBit, int baseStationId,
+        const Parameters& params, uint64_t seed) :
+    params(params), rng{seed}
+{
+    // breadth-first from the hosts without a parent, so that every host
+    // comes after its parent
+    int n = parent.size();
+    std::vector<int> childStart(n + 1, 0), childIds(n), order;
+    for (int i = 0; i < n; ++i)
+        if (parent[i] != -1)
+            childStart[parent[i] + 1]++;
+    for (int i = 0; i < n; ++i)
+        childStart[i + 1] += childStart[i];
+    std::vector<int> next(childStart.begin(), childStart.end() - 1);
+    for (int i = 0; i < n; ++i)
+        if (parent[i] != -1)
+            childIds[next[parent[i]]++] = i;
+    for (int i = 0; i < n; ++i)
+        if (parent[i] == -1)
+            order.push_back(i);
+    for (size_t k = 0; k < order.size(); ++k)
+        for (int c = childStart[order[k]]; c < childStart[order[k] + 1]; ++c)
+            order.push_back(childIds[c]);
+
+    // a host sends only if every hop to the base station has a finite
+    // energy, as a report only counts in the convergecasts if it arrives
+    std::vector<bool> delivers(n, false);
+    for (int u : order)
+        delivers[u] = parent[u] != -1 && energyPerBit[u] < INFINITY && (parent[u] == baseStationId || delivers[parent[u]]);
+
+    // the senders in reverse order, children first, numbered by their
+    // position there; the base station is slot numSenders
+    slot.assign(n, -1);
+    for (auto it = order.rbegin(); it != order.rend(); ++it)
+    {
+        if (!delivers[*it])
+            continue;
+        slot[*it] = senders.size();
+        senders.push_back(*it);
+    }
+    int numSenders = senders.size();
+    slot[baseStationId] = numSenders;
+    target.resize(numSenders);
+    senderEnergyPerBit.resize(numSenders);
+    for (int k = 0; k < numSenders; ++k)
+    {
+        target[k] = slot[parent[senders[k]]];
+        senderEnergyPerBit[k] = energyPerBit[senders[k]];
+    }
+    slot[baseStationId] = -1;
+    numSilent = n - 1 - numSenders;
+    received.assign(numSenders + 1, 0);
+    hostEnergy.assign(numSenders, 0);
+    hostSent.assign(numSenders, 0);
+}
+
+double DataGathering::gatherRound(double scale)
+{
+    // a host has a reading if a 64-bit draw is below the threshold. The
+    // draw is taken even when the reading is certain (both entries are
+    // the payload then), as skipping it would be a branch.
+    bool always = params.reportProbability >= 1;
+    uint64_t threshold = always ? 0 : (uint64_t)std::ldexp(std::max(0.0, params.reportProbability), 64);
+    const double readingBits[2] = {always ? params.payloadBits : 0, params.payloadBits};
+    const double packetBits[2] = {0, params.headerBits};
+    int numSenders = senders.size();
+    double energy = 0;
+    for (int k = 0; k < numSenders; ++k)
+    {
+        double bits = params.aggregationRatio * received[k];
+        received[k] = 0;
+        // both selects index a table, so they cannot become branches
+        bits += readingBits[rng() < threshold];
+        // every packet is new: the header is paid per hop, not forwarded;
+        // a host with nothing to send sends no packet
+        double sent = bits + packetBits[bits != 0];
+        double e = sent * senderEnergyPerBit[k];
+        hostSent[k] += scale * sent;
+        hostEnergy[k] += scale * e;
+        energy += e;
+        received[target[k]] += bits;
+    }
+    deliveredBits += scale * received[numSenders];
+    received[numSenders] = 0;
+
+    // the readings of the hosts without a route are lost
+    long silentReadings = numSilent;
+    if (!always)
+        silentReadings = std::binomial_distribution<long>(numSilent, params.reportProbability)(rng);
+    droppedBits += scale * silentReadings * params.payloadBits;
+    return energy;
+}
+
+void DataGathering::runRound()
+{
+    addRounds(gatherRound(1), 1);
+}
+
+void DataGathering::runRounds(long count)
+{
+    if (count <= 0)
+        return;
+    if (params.reportProbability < 1)
+    {
+        for (long r = 0; r < count; ++r)
+            runRound();
+        return;
+    }
+
+    // every round is the same
+    addRounds(gatherRound(count), count);
+}
+
+void DataGathering::addRounds(double energy, long count)
+{
+    // Welford's update, for count rounds of the same energy at once
+    long total = numRounds + count;
+    double delta = energy - energyMean;
+    energyMean += delta * count / total;
+    energyM2 += delta * delta * numRounds * count / total;
+    totalEnergy += count * energy;
+    numRounds = total;
+}
+
+}; //namespace
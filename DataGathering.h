@@ -0,0 +1,125 @@
+//
+// This file is part of an OMNeT++/OMNEST simulation example.
+//
+// Copyright (C) 1992-2015 Andras Varga
+//
+// This file is distributed WITHOUT ANY WARRANTY. See the file
+// `license' for details on this and other legal matters.
+//
+
+#ifndef __ALOHA_DATAGATHERING_H_
+#define __ALOHA_DATAGATHERING_H_
+
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace aloha {
+
+/**
+ * Data-gathering rounds over a solved tree. In every round each host
+ * senses payloadBits (with probability reportProbability) and, once its
+ * children have sent, sends one packet to its parent with its own bits
+ * plus aggregationRatio times the bits it received: 1 batches everything
+ * it relays, 0 fuses it into its own reading. Every packet carries
+ * headerBits on top.
+ *
+ * Sending b bits costs b * energyPerBit[u], where energyPerBit[u] is the
+ * per-bit energy the energy convergecasts charge for a report passing u:
+ * min(tp1, tp2) for vMER, the SISO energy to the parent for MTD. With
+ * one bit, no header and aggregationRatio 1, a round therefore costs the
+ * convergecast total. As there, only hosts whose every hop to the base
+ * station has a finite energy send; the readings of the others count as
+ * dropped.
+ *
+ * A round is one pass over the sending hosts, children first, so it
+ * costs O(n); with reportProbability 1 every round is the same, and
+ * runRounds() computes one and scales it.
+ */
+class DataGathering
+{
+  public:
+    struct Parameters
+    {
+        double payloadBits = 952;       // sensed per host and round
+        double headerBits = 0;          // per packet
+        double aggregationRatio = 1;    // share of the received bits that is forwarded
+        double reportProbability = 1;   // probability that a host has a reading in a round
+    };
+
+    /**
+     * parent is -1 for the base station and unreachable hosts.
+     */
+    DataGathering(const std::vector<int>& parent, const std::vector<double>& energyPerBit, int baseStationId,
+            const Parameters& params, uint64_t seed);
+
+    void runRound();
+    void runRounds(long numRounds);
+
+    int getNumSenders() const { return senders.size(); }   // hosts with a route to the base station
+    long getNumRounds() const { return numRounds; }
+    double getTotalEnergy() const { return totalEnergy; }           // J, over all rounds
+    double getMeanEnergyPerRound() const { return numRounds > 0 ? totalEnergy / numRounds : 0; }
+    double getEnergyPerRoundStddev() const { return numRounds > 1 ? std::sqrt(energyM2 / (numRounds - 1)) : 0; }
+    double getDeliveredBits() const { return deliveredBits; }       // arrived at the base station
+    double getDroppedBits() const { return droppedBits; }
+    double getEnergyPerDeliveredBit() const { return deliveredBits > 0 ? totalEnergy / deliveredBits : 0; }
+
+    /**
+     * Energy host i spent sending, over all rounds.
+     */
+    double getHostEnergy(int i) const { return slot[i] == -1 ? 0 : hostEnergy[slot[i]]; }
+
+    /**
+     * Bits host i sent, headers included, over all rounds.
+     */
+    double getHostSentBits(int i) const { return slot[i] == -1 ? 0 : hostSent[slot[i]]; }
+
+  private:
+    // splitmix64: one draw per host and round, so it has to be cheap
+    // (std::mt19937_64 took most of the time of a round)
+    struct Random
+    {
+        typedef uint64_t result_type;
+        uint64_t state;
+        static constexpr uint64_t min() { return 0; }
+        static constexpr uint64_t max() { return ~(uint64_t)0; }
+        uint64_t operator()()
+        {
+            uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            return z ^ (z >> 31);
+        }
+    };
+
+    Parameters params;
+    Random rng;
+
+    // the hosts that send, every child before its parent, and per sender
+    // the slot of its parent (numSenders for the base station)
+    std::vector<int> senders;
+    std::vector<int> target;
+    std::vector<double> senderEnergyPerBit;
+    std::vector<int> slot;          // of each host in senders, or -1
+    long numSilent;                 // hosts other than the base station that do not send
+    std::vector<double> received;   // bits received in the current round, per slot
+    std::vector<double> hostEnergy; // per slot
+    std::vector<double> hostSent;   // per slot
+    long numRounds = 0;
+    double totalEnergy = 0;
+    double energyMean = 0;          // of the round energies, and
+    double energyM2 = 0;            // their sum of squared deviations
+    double deliveredBits = 0;
+    double droppedBits = 0;
+
+    // one round; adds scale times its host energies and delivered and
+    // dropped bits, and returns the energy it took
+    double gatherRound(double scale);
+    void addRounds(double energy, long count);
+};
+
+}; //namespace
+
+#endif
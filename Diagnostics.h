@@ -0,0 +1,46 @@
+//
+// This file is part of an OMNeT++/OMNEST simulation example.
+//
+// Copyright (C) 1992-2015 Andras Varga
+//
+// This file is distributed WITHOUT ANY WARRANTY. See the file
+// `license' for details on this and other legal matters.
+//
+
+#ifndef __ALOHA_DIAGNOSTICS_H_
+#define __ALOHA_DIAGNOSTICS_H_
+
+#include <omnetpp.h>
+
+namespace aloha {
+
+/**
+ * Verbosity levels of the protocol log; see Host's verbosity parameter.
+ */
+enum Verbosity
+{
+    VERBOSITY_NONE = 0,     // nothing
+    VERBOSITY_PHASE = 1,    // once per host and phase
+    VERBOSITY_PACKET = 2,   // once per control packet sent
+    VERBOSITY_DETAIL = 3,   // everything a handler looks at, per packet received
+};
+
+}; //namespace
+
+//
+// Highest verbosity compiled in; statements above it are removed by the
+// compiler. Build with e.g. -DALOHA_MAX_VERBOSITY=0 to drop all of them.
+//
+#ifndef ALOHA_MAX_VERBOSITY
+#define ALOHA_MAX_VERBOSITY 3
+#endif
+
+//
+// LOG_AT(level) << ...; logs through EV if level is compiled in and does not
+// exceed the verbosity member of the enclosing object. When it does, the
+// stream expression is not evaluated at all.
+//
+#define LOG_AT(level) \
+    if ((level) > ALOHA_MAX_VERBOSITY || (level) > this->verbosity) ; else EV
+
+#endif
@@ -0,0 +1,98 @@
+//
+// This file is part of an OMNeT++/OMNEST simulation example.
+//
+// Copyright (C) 1992-2015 Andras Varga
+//
+// This file is distributed WITHOUT ANY WARRANTY. See the file
+// `license' for details on this and other legal matters.
+//
+
+#include <cmath>
+
+#include "EnergyTable.h"
+
+using namespace std;
+
+namespace aloha {
+
+void EnergyTable::reset(const NeighborGraph& graph, const RadioModel& radioModel)
+{
+    this->graph = &graph;
+    this->radioModel = radioModel;
+    // start with a slot per host; grow() doubles it as links come in
+    size_t capacity = 64;
+    while ((int)capacity < 2 * graph.getNumNodes())
+        capacity *= 2;
+    slots.assign(capacity, Slot());
+    mask = capacity - 1;
+    count = 0;
+    hits = misses = 0;
+}
+
+EnergyTable::Key EnergyTable::makeKey(int numTx, int numRx, int u, int w, int v, int t)
+{
+    Key key;
+    key.mode = OCCUPIED | (numTx - 1) << 1 | (numRx - 1);
+    if (numTx == 2)
+    {
+        if (numRx == 2) // MIMO: u,w to v,t; the fourth id goes into the mode word
+        {
+            key.a = u; key.b = v; key.c = t;
+            key.mode |= (w + 1) << 3;
+        }
+        else    // MISO: u,v to t
+        {
+            key.a = u; key.b = v; key.c = t;
+        }
+    }
+    else
+    {
+        if (numRx == 2) // SIMO: u to v,t
+        {
+            key.a = u; key.b = v; key.c = t;
+        }
+        else    // SISO: u to v
+        {
+            key.a = u; key.b = v;
+        }
+    }
+    return key;
+}
+
+double EnergyTable::computeEnergyPerBit(int numTx, int numRx, int u, int w, int v, int t) const
+{
+    // the EnergyModel sums, as Host::calculateEnergyConsumptionPerBit() takes them
+    auto d2 = [this](int a, int b) { return (a == -1 || b == -1) ? INFINITY : graph->getSquaredDistance(a, b); };
+    return energyPerBitOfMode(radioModel, numTx, numRx, d2, u, w, v, t);
+}
+
+double EnergyTable::insert(size_t slot, const Key& key, int u, int w, int v, int t)
+{
+    misses++;
+    int numTx = (key.mode >> 1 & 1) + 1;
+    int numRx = (key.mode & 1) + 1;
+    double value = computeEnergyPerBit(numTx, numRx, u, w, v, t);
+    slots[slot].key = key;
+    slots[slot].value = value;
+    if (++count * 2 > slots.size())
+        grow();
+    return value;
+}
+
+void EnergyTable::grow()
+{
+    std::vector<Slot> old(slots.size() * 2);
+    old.swap(slots);
+    mask = slots.size() - 1;
+    for (const Slot& s : old)
+    {
+        if (s.key.mode == EMPTY)
+            continue;
+        size_t i = hash(s.key) & mask;
+        while (slots[i].key.mode != EMPTY)
+            i = (i + 1) & mask;
+        slots[i] = s;
+    }
+}
+
+}; //namespace
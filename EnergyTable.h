@@ -0,0 +1,113 @@
+//
+// This file is part of an OMNeT++/OMNEST simulation example.
+//
+// Copyright (C) 1992-2015 Andras Varga
+//
+// This file is distributed WITHOUT ANY WARRANTY. See the file
+// `license' for details on this and other legal matters.
+//
+
+#ifndef __ALOHA_ENERGYTABLE_H_
+#define __ALOHA_ENERGYTABLE_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "NeighborGraph.h"
+#include "RadioModel.h"
+
+namespace aloha {
+
+/**
+ * Network-wide memo of link energies per bit, filled lazily. A link is
+ * keyed by its mode and the hosts that enter its distance sum, in the
+ * order Host::calculateEnergyConsumptionPerBit() uses them:
+ *
+ *   SISO  u -> v            SIMO  u -> {v, t}
+ *   MISO  {u, v} -> t       MIMO  {u, w} -> {v, t}
+ *
+ * The order is kept (no set canonicalization) so that a memoized value is
+ * bit-identical to a fresh computation. Entries depend only on positions
+ * and radio parameters; RadioMedium resets the table when either changes.
+ *
+ * The table is an open-addressing hash table with linear probing, so
+ * filling it does not allocate per entry.
+ */
+class EnergyTable
+{
+  public:
+    EnergyTable() {}
+
+    /**
+     * Empties the table and binds it to a graph (kept by reference) and a
+     * radio model (copied).
+     */
+    void reset(const NeighborGraph& graph, const RadioModel& radioModel);
+
+    bool isBoundTo(const NeighborGraph& graph, const RadioParameters& params) const { return this->graph == &graph && radioModel.getParameters() == params; }
+
+    /**
+     * Energy per bit of the link; -1 ids (no partner) give INFINITY.
+     */
+    double energyPerBit(int numTx, int numRx, int u, int w, int v, int t)
+    {
+        Key key = makeKey(numTx, numRx, u, w, v, t);
+        size_t i = hash(key) & mask;
+        while (slots[i].key.mode != EMPTY)
+        {
+            if (slots[i].key == key)
+            {
+                hits++;
+                return slots[i].value;
+            }
+            i = (i + 1) & mask;
+        }
+        return insert(i, key, u, w, v, t);
+    }
+
+    /**
+     * The same, without the table; for comparisons.
+     */
+    double computeEnergyPerBit(int numTx, int numRx, int u, int w, int v, int t) const;
+
+    size_t getSize() const { return count; }
+    long getHits() const { return hits; }
+    long getMisses() const { return misses; }
+
+  private:
+    enum { EMPTY = 0, OCCUPIED = 4 };
+    struct Key
+    {
+        int32_t mode = EMPTY;   // OCCUPIED | (numTx-1) << 1 | (numRx-1), MIMO also (w+1) << 3
+        int32_t a = 0, b = 0, c = 0;
+        bool operator==(const Key& k) const { return mode == k.mode && a == k.a && b == k.b && c == k.c; }
+    };
+    struct Slot
+    {
+        Key key;
+        double value = 0;
+    };
+
+    const NeighborGraph *graph = nullptr;
+    RadioModel radioModel;
+    std::vector<Slot> slots;
+    size_t mask = 0;
+    size_t count = 0;
+    long hits = 0;
+    long misses = 0;
+
+    static Key makeKey(int numTx, int numRx, int u, int w, int v, int t);
+    static size_t hash(const Key& key)
+    {
+        uint64_t h = (uint64_t)(uint32_t)key.a * 0x9E3779B97F4A7C15ULL;
+        h ^= ((uint64_t)(uint32_t)key.b << 21 | (uint64_t)(uint32_t)key.c << 42) + (uint64_t)key.mode;
+        h *= 0xBF58476D1CE4E5B9ULL;
+        return (size_t)(h ^ (h >> 31));
+    }
+    double insert(size_t slot, const Key& key, int u, int w, int v, int t);
+    void grow();
+};
+
+}; //namespace
+
+#endif
@@ -8,6 +8,7 @@
 //
 
 #include <algorithm>
+#include <time.h>
 
 #include "Host.h"
 #include <string.h>
@@ -18,63 +19,119 @@ Define_Module(Host);
 
 Host::Host()
 {
-    endTxEvent = nullptr;
 }
 
 Host::~Host()
 {
     delete lastPacket;
-    cancelAndDelete(endTxEvent);
+    for (auto& pool : packetPool)
+        for (cPacket *pk : pool)
+            delete pk;
+    cancelAndDelete(advertiseTimer);
+    for (cMessage *timer : phaseTimers)
+        cancelAndDelete(timer);
+}
+
+const Host::TimerHandler Host::timerHandlers[NUM_TIMER_KINDS] = {
+    &Host::initTxProcess,           // LOCATION
+    &Host::initBellmanFordProcess,  // BELLMAN_FORD
+    &Host::initFamilyProcess,       // FAMILY
+    &Host::initDetectionPhase,      // DETECTION
+    &Host::init_vMER_algo,          // VMER
+    &Host::initEnergyProcess,       // ENERGY
+    &Host::initEnergyMTDProcess,    // ENERGY_MTD
+    &Host::printTotalEnergy,        // PRINT_TOTAL_ENERGY
+    &Host::advertiseShortestPath,   // ADVERTISE_TIMER
+};
+
+const Host::PacketHandler Host::packetHandlers[PhaseCoordinator::NUM_PACKET_KINDS] = {
+    nullptr,
+    nullptr,
+    &Host::handleLocationMessage,   // LOCATION_PACKET
+    &Host::handleBellmanFordMessage, // BELLMAN_FORD_PACKET
+    &Host::setChild,                // PARENT_PACKET
+    &Host::recvDCT,                 // DETECTION_PACKET
+    &Host::recvPTS,                 // PARTNER_SELECT_PACKET
+    &Host::recvRTD,                 // ROUTE_DISCOVERY_PACKET
+    &Host::recvEnergy,              // ENERGY_TO_ROOT_PACKET
+    &Host::recvEnergyMTD,           // ENERGY_TO_ROOT_MTD_PACKET
+};
+
+/**
+ * Returns a control packet of the given kind, reusing a received one if
+ * the pool has any; all fields are set by the caller before sending.
+ */
+template<typename T>
+T *Host::newControlPacket(const char *name, short kind)
+{
+    std::vector<cPacket *>& pool = packetPool[kind];
+    if (pool.empty())
+        return new T(name, kind);
+    T *pk = check_and_cast<T *>(pool.back());
+    pool.pop_back();
+    return pk;
+}
+
+void Host::recycleControlPacket(cPacket *pk)
+{
+    short kind = pk->getKind();
+    if (kind >= 0 && kind < PhaseCoordinator::NUM_PACKET_KINDS && packetPool[kind].size() < maxPooledPackets)
+        packetPool[kind].push_back(pk);
+    else
+        delete pk;
 }
 
-void Host::initialize()
+void Host::initialize(int stage)
 {
+    // in stage 0 the radio medium indexes the host positions
+    if (stage == 0)
+    {
+        if (getEnvir()->getParsimNumPartitions() > 1)
+            throw cRuntimeError("Host cannot run in a partitioned simulation, see README.txt");
+        return;
+    }
+
     stateSignal = registerSignal("state");
+    packetSentSignal = registerSignal("packetSent");
+    packetReceivedSignal = registerSignal("packetReceived");
+    bitsSentSignal = registerSignal("bitsSent");
+    bellmanFordRelaxationSignal = registerSignal("bellmanFordRelaxation");
+    handlerTimeSignal = registerSignal("handlerTime");
+    medium = check_and_cast<RadioMedium *>(getParentModule()->getSubmodule("radioMedium"));
     //server = getModuleByPath("server");
     /*if (!server)
         throw cRuntimeError("server not found");
 */
-    int numHosts = getParentModule()->par("numHosts");
-    hosts = (cModule**)malloc(numHosts * sizeof(cModule));
-    distHosts = new double[numHosts];
-    neighborSet = new bool[numHosts];
-    childrens = new bool[numHosts]();
-    energyHosts = new double[numHosts];
-    shortestPath = new double[numHosts];
-    throughPath = new int[numHosts];
+    hostId = getIndex();
+    hosts = medium->getHosts();
+    graph = &medium->getNeighborGraph();
+    energyTable = medium->getEnergyTable();
+    neighborKnown.assign(graph->getDegree(hostId), false);
+    maxPooledPackets = graph->getDegree(hostId) + 1;
     shortestPathDistance = INFINITY;
 
-    for (int i = 0; i < numHosts; ++i)
-    {
-        char text[10] = {0};
-        shortestPath[i] = INFINITY;
-        energyHosts[i]  = INFINITY;
-
-
-        sprintf(text, "host[%d]", i);
-        hosts[i] = getModuleByPath(text);
-        if (hosts[i]->getId() == getId())
-        {
-            hostId = i;
-        }
-    }
-
     txRate = par("txRate");
     //iaTime = &par("iaTime");
     pkLenBits = &par("pkLenBits");
 
     slotTime = par("slotTime");
     isSlotted = slotTime > 0;
-    WATCH(slotTime);
-    WATCH(isSlotted);
-    int *p2 = new int[10]();    // block of ten ints value initialized to 0
+    headless = par("headless");
+    verbosity = par("verbosity");
 
-    endTxEvent = new cMessage("send/endTx");
+    for (int i = 0; i < PhaseCoordinator::NUM_PHASES; ++i)
+        phaseTimers[i] = new cMessage(PhaseCoordinator::getPhaseName(i), i);
+    advertiseTimer = new cMessage("advertise", ADVERTISE_TIMER);
     state = IDLE;
-    emit(stateSignal, state);
     pkCounter = 0;
-    WATCH((int&)state);
-    WATCH(pkCounter);
+    if (!headless)
+    {
+        emit(stateSignal, state);
+        WATCH(slotTime);
+        WATCH(isSlotted);
+        WATCH((int&)state);
+        WATCH(pkCounter);
+    }
 
     x = par("x").doubleValue();
     y = par("y").doubleValue();
@@ -89,448 +146,309 @@ void Host::initialize()
     //double dist = std::sqrt((x-serverX) * (x-serverX) + (y-serverY) * (y-serverY));
    //radioDelay = dist / propagationSpeed;
 
-    getDisplayString().setTagArg("p", 0, x);
-    getDisplayString().setTagArg("p", 1, y);
-    if (true || getId() == 3)
+    if (!headless)
     {
-        cMessage *msg = new cMessage("initTx");
-        scheduleAt(simTime(), msg);
+        getDisplayString().setTagArg("p", 0, x);
+        getDisplayString().setTagArg("p", 1, y);
     }
 
-    if (getId() == hosts[0]->getId())
+    // a tree recorded for this placement by an earlier run replaces the
+    // location, Bellman-Ford and family phases
+    const TreeSnapshot *tree = medium->getTreeSnapshot();
+    if (tree != nullptr)
     {
-        {
-            cMessage *msg = new cMessage("initBellmanFord");
-            scheduleAt(simTime() + 0.2, msg);
-        }
-        {
-            cMessage *msg = new cMessage("initDetection");
-            scheduleAt(4, msg);
-        }
-        {
-            cMessage *msg = new cMessage("init_vMER");
-            scheduleAt(6, msg);
-        }
-        {
-            cMessage *msg = new cMessage("printTotalEnergy");
-            scheduleAt(12, msg);
-        }
-
+        restoreTree(*tree);
     }
 
-    cMessage *msg = new cMessage("initFamily");
-    scheduleAt(3, msg);
-    {
+    // the phases themselves are started by the coordinator, see startPhase()
+    coordinator = check_and_cast<PhaseCoordinator *>(getParentModule()->getSubmodule("coordinator"));
+    profileHandlers = coordinator->isProfilingHandlers();
 
-        cMessage *msg = new cMessage("initEnergy");
-        scheduleAt(7, msg);
+    const char *treeProtocol = getParentModule()->par("treeProtocol");
+    if (strcmp(treeProtocol, "ordered") == 0)
+        orderedRelaxation = true;
+    else if (strcmp(treeProtocol, "bellmanFord") != 0)
+        throw cRuntimeError("Unknown treeProtocol \"%s\", expected bellmanFord or ordered", treeProtocol);
+    const char *routeDiscoveryScope = getParentModule()->par("routeDiscoveryScope");
+    if (strcmp(routeDiscoveryScope, "tree") == 0)
+        treeScopedRouteDiscovery = true;
+    else if (strcmp(routeDiscoveryScope, "neighbors") != 0)
+        throw cRuntimeError("Unknown routeDiscoveryScope \"%s\", expected neighbors or tree", routeDiscoveryScope);
+    double maxRange = medium->getMaxRange();
+    relaxationDelayPerCost = getParentModule()->par("orderedRelaxationDelay").doubleValue() / (maxRange * maxRange);
+}
 
-    }
-    {
+void Host::startPhase(int phase)
+{
+    Enter_Method_Silent();
+    coordinator->activityStarted();
+    scheduleAt(simTime(), phaseTimers[phase]);
+}
 
-        cMessage *msg = new cMessage("initEnergyMTD");
-        scheduleAt(10, msg);
+void Host::restoreTree(const TreeSnapshot& tree)
+{
+    neighborKnown.assign(neighborKnown.size(), true);
+    myParentId = tree.parent[hostId];
+    shortestPathDistance = tree.shortestPathDistance[hostId];
+    shortestPathVia = myParentId == -1 && shortestPathDistance == 0 ? hostId : myParentId;
+    children.assign(tree.childIds.begin() + tree.childStart[hostId], tree.childIds.begin() + tree.childStart[hostId + 1]);
+}
 
-    }
-    //scheduleAt(getNextTransmissionTime(), endTxEvent);
+void Host::finish()
+{
+    medium->recordTreeState(hostId, myParentId, shortestPathDistance);
 }
 
 void Host::setChild(cMessage* msg)
 {
-    const char* messageText = msg->getName();
-    int hostNumber = -1;
-    //papa-000
-    sscanf(messageText, "%*5s%3d", &hostNumber);
+    ParentPacket* pkt = check_and_cast<ParentPacket*>(msg);
+    int hostNumber = pkt->getChildId();
     if (hostNumber != -1) {
-        childrens[hostNumber] = true;
+        auto it = std::lower_bound(children.begin(), children.end(), hostNumber);
+        if (it == children.end() || *it != hostNumber)
+            children.insert(it, hostNumber);
     }
 }
 
 void Host::initTxProcess() {
-    int numHosts = getParentModule()->par("numHosts");
-    double maxRange = getParentModule()->par("maxRange");
-    simtime_t _duration;
-    for (int i = 0; i < numHosts; ++i) {
-        if (getId() == hosts[i]->getId())
-            continue;
-
-        // generate packet and schedule timer when it ends
-        double hostX = hosts[i]->par("x").doubleValue();
-        double hostY = hosts[i]->par("y").doubleValue();
-        double dist = std::sqrt(
-                (x - hostX) * (x - hostX) + (y - hostY) * (y - hostY));
-        distHosts[i] = dist;
-        if (dist > maxRange) {
-            distHosts[i] = INFINITY;
-            continue;
-        }
-        radioDelay = dist / propagationSpeed;
-        char pkname[40];
-        sprintf(pkname, "locationPacket-%03d-#%03d", hostId, pkCounter++);
-        EV  << "generating packet " << pkname << endl;
-        state = TRANSMIT;
-        emit(stateSignal, state);
-        cPacket* pk = new cPacket(pkname);
-        char parPower[40] = { 0 };
-        pk->setBitLength(pkLenBits->intValue());
-        simtime_t duration = pk->getBitLength() / txRate;
-        _duration = duration;
-        pk->setKind(2);
-        //pk->setName("loc");
-        sendDirect(pk, radioDelay, duration, hosts[i]->gate("in"));
-        // let visualization code know about the new packet
-        if (transmissionRing != nullptr) {
-            delete lastPacket;
-            lastPacket = pk->dup();
-        }
+    // only hosts within maxRange get our location; they are our graph row
+    for (int e = graph->getEdgeBegin(hostId); e < graph->getEdgeEnd(hostId); ++e) {
+        int i = graph->getNeighborId(e);
+        pkCounter++;
+        LOG_AT(VERBOSITY_PACKET) << "generating location packet #" << pkCounter << " for host[" << i << "]" << endl;
+        LocationPacket* pk = newControlPacket<LocationPacket>("location", LOCATION_PACKET);
+        pk->setSenderId(hostId);
+        pk->setSenderX(x);
+        pk->setSenderY(y);
+        sendControlPacket(pk, i);
     }
 }
 
 void Host::initBellmanFordProcess() {
     int hostNumber = getParentModule()->par("baseStationId");
-    EV  << "Running Bellman-Ford from base station node #" << hostNumber << endl;
-    int numHosts = getParentModule()->par("numHosts");
-    simtime_t _duration;
-    shortestPath[hostId] = 0;
+    LOG_AT(VERBOSITY_PHASE) << "Running Bellman-Ford from base station node #" << hostNumber << endl;
+    shortestPathVia = hostId;
     shortestPathDistance = 0;
-    for (int i = 0; i < numHosts; ++i) {
-        if (!neighborSet[i])
+    advertiseShortestPath();
+}
+
+void Host::advertiseShortestPath()
+{
+    for (int e = graph->getEdgeBegin(hostId); e < graph->getEdgeEnd(hostId); ++e)
+    {
+        if (!neighborKnown[e - graph->getEdgeBegin(hostId)])
             continue;
 
-        // generate packet and schedule timer when it ends
-        double hostX = hosts[i]->par("x").doubleValue();
-        double hostY = hosts[i]->par("y").doubleValue();
-        double dist = std::sqrt(
-                (x - hostX) * (x - hostX) + (y - hostY) * (y - hostY));
-        distHosts[i] = dist;
-        radioDelay = dist / propagationSpeed;
-        char pkname[60];
-        sprintf(pkname, "BellmanFord-%03d-d=%012.3f", 0, 0);
-        EV  << "generating packet " << pkname << endl;
-        state = TRANSMIT;
-        emit(stateSignal, state);
-        cPacket* pk = new cPacket(pkname);
-        pk->setBitLength(pkLenBits->intValue());
-        simtime_t duration = pk->getBitLength() / txRate;
-        _duration = duration;
-        pk->setKind(3);
-        sendDirect(pk, radioDelay, duration, hosts[i]->gate("in"));
-        if (transmissionRing != nullptr) {
-            delete lastPacket;
-            lastPacket = pk->dup();
-        }
+        int i = graph->getNeighborId(e);
+        LOG_AT(VERBOSITY_PACKET) << "generating BellmanFord packet d=" << shortestPathDistance << " for host[" << i << "]" << endl;
+        BellmanFordPacket* pk = newControlPacket<BellmanFordPacket>("BellmanFord", BELLMAN_FORD_PACKET);
+        pk->setSenderId(hostId);
+        pk->setDistance(shortestPathDistance);
+        sendControlPacket(pk, i);
     }
 }
 
-void Host::initFamilyProcess() {
-    int numHosts = getParentModule()->par("numHosts");
-    double maxRange = getParentModule()->par("maxRange");
-    simtime_t _duration;
-    int i = -1;
-    double min = INFINITY;
-    for (int j = 0; j < numHosts; ++j)
+void Host::scheduleAdvertisement()
+{
+    // advertisements go out roughly in increasing cost order, as in
+    // Dijkstra, so most hosts advertise their final cost only once;
+    // a better cost arriving before the timer fires just moves it
+    simtime_t at = coordinator->getPhaseStartTime(PhaseCoordinator::BELLMAN_FORD) + shortestPathDistance * relaxationDelayPerCost;
+    if (at < simTime())
+        at = simTime();
+    if (!advertiseTimer->isScheduled())
     {
-        if (shortestPath[j] == shortestPathDistance)
-        {
-            //min = shortestPath[j];
-            i = j;
-        }
+        coordinator->activityStarted();
+    }
+    else
+    {
+        cancelEvent(advertiseTimer);
     }
+    scheduleAt(at, advertiseTimer);
+}
+
+void Host::initFamilyProcess() {
+    double maxRange = medium->getMaxRange();
+    int i = shortestPathVia;
     //found my papa, now set myParent
     if (i == hostId)
     {
         return;
     }
-    if (distHosts[i] > maxRange)
+    if (i == -1 || getDistanceTo(i) > maxRange)
     {
         myParentId = -1;
         return;
     }
     myParentId = i;
-    cout << "Distance: " << min << endl;
-    cout << "Telling parent I'm its children #" << i << endl;
-    // generate packet and schedule timer when it ends
-    double hostX = hosts[i]->par("x").doubleValue();
-    double hostY = hosts[i]->par("y").doubleValue();
-    double dist = std::sqrt((x - hostX) * (x - hostX) + (y - hostY) * (y - hostY));
-    distHosts[i] = dist;
-    radioDelay = dist / propagationSpeed;
-    char pkname[60];
-    sprintf(pkname, "papa-%03d", hostId);
-    EV  << "generating packet " << pkname << endl;
-    state = TRANSMIT;
-    emit(stateSignal, state);
-    cPacket* pk = new cPacket(pkname);
-    pk->setBitLength(pkLenBits->intValue());
-    simtime_t duration = pk->getBitLength() / txRate;
-    _duration = duration;
-    pk->setKind(4);
-    sendDirect(pk, radioDelay, duration, hosts[i]->gate("in"));
-    if (transmissionRing != nullptr) {
-        delete lastPacket;
-        lastPacket = pk->dup();
-    }
+    LOG_AT(VERBOSITY_PACKET) << "generating papa packet for host[" << i << "]" << endl;
+    ParentPacket* pk = newControlPacket<ParentPacket>("papa", PARENT_PACKET);
+    pk->setChildId(hostId);
+    sendControlPacket(pk, i);
 }
 
 void Host::initDetectionPhase()
 {
-    int numHosts = getParentModule()->par("numHosts");
-    for (int i = 0; i < numHosts; ++i)
+    for (int i : children)
     {
-        if (!childrens[i])
-            continue;
-
-        if (i == hostId)
-        {
-            continue;
-        }
         sendDCT(i, 0, 0);
     }
 }
 void Host::init_vMER_algo()
 {
-    int numHosts = getParentModule()->par("numHosts");
-    for (int i = 0; i < numHosts; ++i)
+    for (int i : children)
     {
-        if (!childrens[i])
-            continue;
-
-        if (i == hostId)
-        {
-            continue;
-        }
         sendRTD(i, 0, INFINITY);
     }
 }
+void Host::initEnergyProcess()
+{
+    if (this->myParentId != -1)
+    {
+        double energy = std::min(tp1,tp2);
+        sendEnergy(energy);
+    }
+}
+void Host::initEnergyMTDProcess()
+{
+    if (this->myParentId != -1)
+    {
+        double energy = getEnergyToParentSISO();
+        sendEnergyMTD(energy);
+    }
+}
+void Host::printTotalEnergy()
+{
+    cout << totalEnergy << endl;
+    cout << totalEnergyMTD << endl;
+    simsignal_t energyMTD = getParentModule()->registerSignal("mtd_calc");
+    simsignal_t energyMIMO = getParentModule()->registerSignal("mimo_calc");
+
+    emit(energyMTD, totalEnergyMTD);
+    emit(energyMIMO, totalEnergy);
+}
 
 void Host::handleLocationMessage(cMessage* msg)
 {
-    cPacket* pkt = check_and_cast<cPacket*>(msg);
-    EV << pkt->getName() << endl;
-    int i = 0;
-    int numHosts = getParentModule()->par("numHosts");
-    //"get sender x y"
-    for (int i = 0; i < numHosts; ++i)
+    LocationPacket* pkt = check_and_cast<LocationPacket*>(msg);
+    LOG_AT(VERBOSITY_DETAIL) << "location of host[" << pkt->getSenderId() << "]: (" << pkt->getSenderX() << ", " << pkt->getSenderY() << ")" << endl;
+    int i = pkt->getSenderId();
+    int e = graph->findEdge(hostId, i);
+    if (e != -1)
     {
-        double hostX = hosts[i]->par("x").doubleValue();
-        double hostY = hosts[i]->par("y").doubleValue();
-        double maxRange = getParentModule()->par("maxRange");
-        if (distHosts[i] <= maxRange && getId() != hosts[i]->getId())
-        {
-            neighborSet[i] = true;
-            //energyHosts[i] = 1;
-        }
-        else
-        {
-            neighborSet[i] = false;
-        }
-        for (int i = 0; i < numHosts; ++i)
-        {
-            EV << "Host " << i << ": distance:" << distHosts[i]  << "   neighbor?  " << neighborSet[i] << "   " << endl;
-        }
+        neighborKnown[e - graph->getEdgeBegin(hostId)] = true;
+        LOG_AT(VERBOSITY_DETAIL) << "Host " << i << ": distance:" << graph->getEdgeDistance(e) << "   neighbor?  " << true << "   " << endl;
     }
 }
 
 void Host::handleBellmanFordMessage(cMessage* msg)
 {
-    double newDistance = 0;
-    int senderHost = 0;
-    const char* messageText = msg->getName();
-    sscanf(messageText, "%*18s%lf", &newDistance);
-    sscanf(messageText, "%*12s%03d", &senderHost);
-    int hostNumber = getParentModule()->par("baseStationId");
-    EV << "Running Bellman-Ford from base station node #" << hostNumber << endl;
-    int numHosts = getParentModule()->par("numHosts");
-    simtime_t _duration;
-    double _dist = distHosts[senderHost];
-    EV << "My Distance to #" << senderHost << " d=" << _dist << endl;
-    EV << "New Distance from #" << senderHost << " d=" << newDistance << endl;
-    EV << "My Best d=" << shortestPathDistance << endl;
-    if (std::pow(_dist, 2) + newDistance < shortestPathDistance)
+    BellmanFordPacket* pkt = check_and_cast<BellmanFordPacket*>(msg);
+    double newDistance = pkt->getDistance();
+    int senderHost = pkt->getSenderId();
+    LOG_AT(VERBOSITY_DETAIL) << "My Distance to #" << senderHost << " d=" << getDistanceTo(senderHost) << endl;
+    LOG_AT(VERBOSITY_DETAIL) << "New Distance from #" << senderHost << " d=" << newDistance << endl;
+    LOG_AT(VERBOSITY_DETAIL) << "My Best d=" << shortestPathDistance << endl;
+    if (getSquaredDistanceTo(senderHost) + newDistance < shortestPathDistance)
     {
-        shortestPathDistance = std::pow(_dist, 2) + newDistance;
-        shortestPath[senderHost] = shortestPathDistance;
-    EV << "Found better path through host[" << senderHost << "] d=" << shortestPathDistance << endl;
+        shortestPathDistance = getSquaredDistanceTo(senderHost) + newDistance;
+        shortestPathVia = senderHost;
+        emit(bellmanFordRelaxationSignal, shortestPathDistance);
+        coordinator->bellmanFordRelaxed();
+    LOG_AT(VERBOSITY_DETAIL) << "Found better path through host[" << senderHost << "] d=" << shortestPathDistance << endl;
     }
     else
     {
         return;
     }
-    for (int i = 0; i < numHosts; ++i)
-    {
-        if (!neighborSet[i])
-            continue;
-
-        double dist = distHosts[i];
-        radioDelay = dist / propagationSpeed;
-        char pkname[60];
-        sprintf(pkname, "BellmanFord-%03d-d=%012.5f", hostId, shortestPathDistance);
-        EV << "generating packet " << pkname << endl;
-        state = TRANSMIT;
-        emit(stateSignal, state);
-        cPacket* pk = new cPacket(pkname);
-        pk->setBitLength(pkLenBits->intValue());
-        simtime_t duration = pk->getBitLength() / txRate;
-        _duration = duration;
-        pk->setKind(3);
-        sendDirect(pk, radioDelay, duration, hosts[i]->gate("in"));
-        if (transmissionRing != nullptr)
-        {
-            delete lastPacket;
-            lastPacket = pk->dup();
-        }
-    }
+    if (orderedRelaxation)
+        scheduleAdvertisement();
+    else
+        advertiseShortestPath();
 }
 
 void Host::sendEnergy(double energy)
 {
-    double maxRange = getParentModule()->par("maxRange");
-    simtime_t _duration;
-    // generate packet and schedule timer when it ends
-    double hostX = hosts[this->myParentId]->par("x").doubleValue();
-    double hostY = hosts[this->myParentId]->par("y").doubleValue();
-    double dist = std::sqrt(
-            (x - hostX) * (x - hostX) + (y - hostY) * (y - hostY));
-    radioDelay = dist / propagationSpeed;
-    char pkname[90];
-    sprintf(pkname, "EnergyToRoot-%03d-%042.38lf", this->hostId, energy);
-    EV  << "generating packet " << pkname << endl;
-    state = TRANSMIT;
-    emit(stateSignal, state);
-    cPacket* pk = new cPacket(pkname);
-    char parPower[40] = { 0 };
-    pk->setBitLength(pkLenBits->intValue());
-    simtime_t duration = pk->getBitLength() / txRate;
-    pk->setKind(8);
-    sendDirect(pk, radioDelay, duration, hosts[myParentId]->gate("in"));
-    // let visualization code know about the new packet
-    if (transmissionRing != nullptr) {
-        delete lastPacket;
-        lastPacket = pk->dup();
-    }
+    LOG_AT(VERBOSITY_PACKET) << "generating EnergyToRoot packet energy=" << energy << endl;
+    EnergyPacket* pk = newControlPacket<EnergyPacket>("EnergyToRoot", ENERGY_TO_ROOT_PACKET);
+    pk->setSenderId(hostId);
+    pk->setEnergy(energy);
+    sendControlPacket(pk, myParentId);
 }
 void Host::sendEnergyMTD(double energy)
 {
-    double maxRange = getParentModule()->par("maxRange");
-    simtime_t _duration;
+    LOG_AT(VERBOSITY_PACKET) << "generating EnergyToRootMTD packet energy=" << energy << endl;
+    EnergyPacket* pk = newControlPacket<EnergyPacket>("EnergyToRootMTD", ENERGY_TO_ROOT_MTD_PACKET);
+    pk->setSenderId(hostId);
+    pk->setEnergy(energy);
+    sendControlPacket(pk, myParentId);
+}
+void Host::sendControlPacket(cPacket *pk, int targetHost)
+{
     // generate packet and schedule timer when it ends
-    double hostX = hosts[this->myParentId]->par("x").doubleValue();
-    double hostY = hosts[this->myParentId]->par("y").doubleValue();
-    double dist = std::sqrt(
-            (x - hostX) * (x - hostX) + (y - hostY) * (y - hostY));
+    double dist = getDistanceTo(targetHost);
     radioDelay = dist / propagationSpeed;
-    char pkname[90];
-    sprintf(pkname, "EnergyToRootMTD-%03d-%042.38lf", this->hostId, energy);
-    EV  << "generating packet " << pkname << endl;
-    state = TRANSMIT;
-    emit(stateSignal, state);
-    cPacket* pk = new cPacket(pkname);
-    char parPower[40] = { 0 };
+    if (!headless)
+    {
+        state = TRANSMIT;
+        emit(stateSignal, state);
+    }
     pk->setBitLength(pkLenBits->intValue());
     simtime_t duration = pk->getBitLength() / txRate;
-    pk->setKind(9);
-    sendDirect(pk, radioDelay, duration, hosts[myParentId]->gate("in"));
+    emit(packetSentSignal, (long)pk->getKind());
+    emit(bitsSentSignal, (long)pk->getBitLength());
+    coordinator->packetSent(pk->getKind(), pk->getBitLength(), hostId, targetHost);
+    sendDirect(pk, radioDelay, duration, hosts[targetHost]->gate("in"));
     // let visualization code know about the new packet
-    if (transmissionRing != nullptr) {
+    if (!headless && transmissionRing != nullptr) {
         delete lastPacket;
         lastPacket = pk->dup();
     }
 }
+// CPU time of the calling thread in s; unlike wall time it leaves out the
+// time the process waits for a core, e.g. under runbatch -j N
+static double getThreadCpuTime()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
 void Host::handleMessage(cMessage *msg)
 {
-    //ASSERT(msg == endTxEvent);
+    double handlerStart = 0;
+    if (profileHandlers)
+        handlerStart = getThreadCpuTime();
+    int kind = msg->isSelfMessage() ? 0 : msg->getKind();
+    int sender = msg->isSelfMessage() ? hostId : msg->getSenderModule()->getIndex();
+    if (!msg->isSelfMessage())
+        emit(packetReceivedSignal, (long)kind);
 
+    // timers are ours to reschedule; packets go back to the pool
     if (msg->isSelfMessage())
     {
-        if (strcmp(msg->getName(), "initTx") == 0)
-        {
-            initTxProcess();
-        }
-        else if (strcmp(msg->getName(), "initBellmanFord") == 0)
-        {
-            initBellmanFordProcess();
-        }
-        else if (strcmp(msg->getName(), "initFamily") == 0)
-        {
-            initFamilyProcess();
-        }
-        else if (strcmp(msg->getName(), "initDetection") == 0)
-        {
-            initDetectionPhase();
-        }
-        else if (strcmp(msg->getName(), "init_vMER") == 0)
-        {
-            init_vMER_algo();
-        }
-        else if (strcmp(msg->getName(), "initEnergy") == 0)
-        {
-           if (this->myParentId != -1)
-           {
-               double energy = std::min(tp1,tp2);
-               sendEnergy(energy);
-           }
-               //cout << "host[" << hostId << "] -> BaseNode: " << temp << endl;
-        }
-        else if (strcmp(msg->getName(), "initEnergyMTD") == 0)
-        {
-           if (this->myParentId != -1)
-           {
-               double energy = getEnergyToParentSISO();
-               sendEnergyMTD(energy);
-           }
-               //cout << "host[" << hostId << "] -> BaseNode: " << temp << endl;
-        }
-        else if (strcmp(msg->getName(), "printTotalEnergy") == 0)
-        {
-            cout << totalEnergy << endl;
-            cout << totalEnergyMTD << endl;
-            simsignal_t energyMTD = getParentModule()->registerSignal("mtd_calc");
-            simsignal_t energyMIMO = getParentModule()->registerSignal("mimo_calc");
-
-            emit(energyMTD, totalEnergyMTD);
-            emit(energyMIMO, totalEnergy);
-               //cout << "host[" << hostId << "] -> BaseNode: " << temp << endl;
-        }
+        short timerKind = msg->getKind();
+        if (timerKind < 0 || timerKind >= NUM_TIMER_KINDS)
+            throw cRuntimeError("Unexpected timer kind %d", timerKind);
+        (this->*timerHandlers[timerKind])();
     }
-    else    //message from the outside
+    else
     {
-        //if msg is loc
-        if(msg->getKind()       == 2)
-        {
-            handleLocationMessage(msg);
-        }
-        else if (msg->getKind() == 3)
-        {
-            handleBellmanFordMessage(msg);
-        }
-        else if (msg->getKind() == 4)
-        {
-            setChild(msg);
-        }
-        else if (msg->getKind() == 5)
-        {
-            recvDCT(msg);
-        }
-        else if (msg->getKind() == 6)
-        {
-            recvPTS(msg);
-        }
-        else if (msg->getKind() == 7)
-        {
-            if(rtdTerminated)
-                return;
-            recvRTD(msg);
-        }
-        else if (msg->getKind() == 8)
-        {
-            recvEnergy(msg);
-        }
-        else if (msg->getKind() == 9)
-        {
-            recvEnergyMTD(msg);
-        }
+        PacketHandler handler = kind < PhaseCoordinator::NUM_PACKET_KINDS ? packetHandlers[kind] : nullptr;
+        if (handler == nullptr)
+            throw cRuntimeError("Unexpected control packet kind %d", kind);
+        (this->*handler)(msg);
+        recycleControlPacket(check_and_cast<cPacket *>(msg));
     }
-    delete msg;
+
+    double handlerTime = 0;
+    if (profileHandlers)
+    {
+        handlerTime = getThreadCpuTime() - handlerStart;
+        emit(handlerTimeSignal, handlerTime);
+    }
+    coordinator->messageHandled(kind, hostId, sender, handlerTime);
+    coordinator->activityFinished();
 }
 
 simtime_t Host::getNextTransmissionTime()
@@ -546,6 +464,9 @@ simtime_t Host::getNextTransmissionTime()
 
 void Host::refreshDisplay() const
 {
+    if (headless)
+        return;
+
     cCanvas *canvas = getParentModule()->getCanvas();
     const int numCircles = 20;
     const double circleLineWidth = 10;
@@ -659,111 +580,29 @@ void Host::refreshDisplay() const
 }
 double Host::calculateEnergyConsumptionPerBit(int _w, int _v,  int _t, int numTx, int numRx ,int bitsCount)
 {
+    // w is always myPartnerId; the getters call linkEnergyPerBit<>() directly
+    if (energyTable)
+        return energyTable->energyPerBit(numTx, numRx, hostId, myPartnerId, _v, _t);
+    auto d2 = [this](int a, int b) { return (a == -1 || b == -1) ? INFINITY : graph->getSquaredDistance(a, b); };
+    return energyPerBitOfMode(medium->getRadioModel(), numTx, numRx, d2, hostId, myPartnerId, _v, _t);
+}
+template<int NumTx, int NumRx>
+double Host::linkEnergyPerBit(int v, int t)
+{
+    if (energyTable)
+        return energyTable->energyPerBit(NumTx, NumRx, hostId, myPartnerId, v, t);
 
-
-    double energyPerBit = 0;
-    double constSize = getParentModule()->par("constellation").doubleValue();
-    double epsilon = 3*(std::sqrt(std::pow(2,constSize))-1)/(std::sqrt(std::pow(2,constSize))+1);
-    double pBitError = getParentModule()->par("bitErrorProbability").doubleValue();
-    double gain = std::pow(10,getParentModule()->par("rxtxGain").doubleValue()/10);
-    double lambda = getParentModule()->par("waveLength").doubleValue();
-    double spectralDensity = std::pow(10,(getParentModule()->par("noiseSpectralDensity").doubleValue()-30)/10);
-    double alpha = (epsilon / 0.35) - 1;
-    double Ml = std::pow(10,getParentModule()->par("linkMargin").doubleValue()/10);
-    double NF = std::pow(10,getParentModule()->par("rxNoiseFigure").doubleValue()/10);
-
-    double Ptc = getParentModule()->par("txConsumption").doubleValue();
-    double Psyn = getParentModule()->par("synConsumption").doubleValue();
-    double Prc = getParentModule()->par("rxConsumption").doubleValue();
-    Ptc /= 1000;
-    Psyn /= 1000;
-    Prc /= 1000;
-    double BW = getParentModule()->par("bandWidth").doubleValue();
-
-    double systemEnergy=0;
-    systemEnergy = ((numTx*Ptc)+(2*Psyn)+(numRx*Prc))/(BW*constSize);
-    Host *w;
-    int _u = this->hostId;
-    if (this->myPartnerId != -1)
-    {
-        w = check_and_cast<Host *>(hosts[this->myPartnerId]);
-    }
-    Host *v;
-    if (_v != -1)
-    {
-        v = check_and_cast<Host *>(hosts[_v]);
-    }
-
-    Host *t = check_and_cast<Host *>(hosts[_t]);
-    Host *u = check_and_cast<Host *>(hosts[_u]);
-
-    double dSum = 0;
-    if (numTx == 2)
-    {
-        if (numRx == 2) //MIMO
-        {
-            //u,w to v,t
-            dSum = std::pow(u->distHosts[v->hostId],2) +  std::pow(u->distHosts[t->hostId],2) + std::pow(w->distHosts[v->hostId],2) + std::pow(w->distHosts[t->hostId],2);
-            //energyPerBit = ?;
-        }
-        else    //MISO
-        {
-            //u,v to t
-            //d_ut^2 + d_vt^2
-            dSum =  std::pow(u->distHosts[t->hostId],2) + std::pow(v->distHosts[t->hostId],2);
-        }
-    }
-    else
-    {
-        if (numRx == 2)   //SIMO
-        {
-            //u to v,t
-            //d_uv^2 + d_ut^2
-            dSum =  std::pow(u->distHosts[v->hostId],2) + std::pow(u->distHosts[t->hostId],2);
-        }
-        else    //SISO
-        {
-            //u to v
-            if (_v == -1)
-            {
-                dSum = INFINITY;
-            }
-            else
-            {
-                dSum =  std::pow(u->distHosts[v->hostId],2);
-            }
-        }
-    }
-    dSum = (dSum*Ml*NF)/(gain*std::pow(lambda,2));
-
-    energyPerBit = (2.0/3.0)*(1 + alpha) * std::pow(pBitError / 4 , -(1/(numTx*numRx)))*((std::pow(2,constSize) - 1)/(std::pow(constSize, (1/(numTx*numRx+1)))))*spectralDensity*dSum + systemEnergy;
-
-    return energyPerBit;
+    // squared distances come straight from the shared graph; a missing
+    // partner (-1) or an out-of-range pair counts as an infinite distance
+    auto d2 = [this](int a, int b) { return (a == -1 || b == -1) ? INFINITY : graph->getSquaredDistance(a, b); };
+    return EnergyModel<NumTx, NumRx>::energyPerBit(medium->getRadioModel(), d2, hostId, myPartnerId, v, t);
 }
 void Host::recvPTS(cMessage* msg)
 {
-    const char *messageText = msg->getName();
-    int numHosts = getParentModule()->par("numHosts");
-    //PartnerSelect-000-pts(000,000)
-    int senderHost = 0;
-    sscanf(messageText, "%*14s%03d", &senderHost);
-    for (int i = 0; i < numHosts; ++i)
+    PartnerSelectPacket *pkt = check_and_cast<PartnerSelectPacket *>(msg);
+    int senderHost = pkt->getSenderId();
+    for (int i : children)
     {
-        double weight = 0;
-        if (hostId == 6)
-        {
-            cout << "host["<< i <<  "] is children: " << !childrens[i] << endl;
-            cout << "I am: " << hostId << endl;
-        }
-        if (!childrens[i]) //if not my child, skip
-        {
-            continue;
-        }
-        //else
-        if (i == hostId)
-        {
-            continue;
-        }
         sendDCT(i, 1, senderHost);
     }
     setPartner(senderHost);
@@ -771,14 +610,8 @@ void Host::recvPTS(cMessage* msg)
 }
 void Host::recvEnergy(cMessage* msg)
 {
-    const char *messageText = msg->getName();
-    int numHosts = getParentModule()->par("numHosts");
-    //PartnerSelect-000-pts(000,000)
-    int senderHost = 0;
-    double energy = 0;
-
-    sscanf(messageText, "%*13s%03d", &senderHost);
-    sscanf(messageText, "%*17s%lf", &energy);
+    EnergyPacket *pkt = check_and_cast<EnergyPacket *>(msg);
+    double energy = pkt->getEnergy();
     if (this->myParentId != -1)
     {
         double temp = std::min(tp1,tp2);
@@ -796,17 +629,11 @@ void Host::recvEnergy(cMessage* msg)
 }
 void Host::recvEnergyMTD(cMessage* msg)
 {
-    const char *messageText = msg->getName();
-    int numHosts = getParentModule()->par("numHosts");
-    //PartnerSelect-000-pts(000,000)
-    int senderHost = 0;
-    double energy = 0;
-
-    sscanf(messageText, "%*16s%03d", &senderHost);
-    sscanf(messageText, "%*20s%lf", &energy);
+    EnergyPacket *pkt = check_and_cast<EnergyPacket *>(msg);
+    double energy = pkt->getEnergy();
     if (this->myParentId != -1)
     {
-        double temp = calculateEnergyConsumptionPerBit(0, this->myParentId, 0, 1, 1, 1);
+        double temp = linkEnergyPerBit<1, 1>(this->myParentId, 0);
         if (energy + temp != INFINITY)
             sendEnergyMTD(energy + temp);
     }
@@ -822,67 +649,47 @@ void Host::recvEnergyMTD(cMessage* msg)
 void Host::recvDCT(cMessage* msg)
 {
 
-    const char *messageText = msg->getName();
-    int numHosts = getParentModule()->par("numHosts");
-    //Detection-%03d-dct(%01d,%03d)
-    int senderHost = 0;
-    int isPaired = 0;
-    int pairedId = 0;
-    sscanf(messageText, "%*10s%03d", &senderHost);
-    sscanf(messageText, "%*18s%1d", &isPaired);
-    sscanf(messageText, "%*20s%03d", &pairedId);
+    DetectionPacket *pkt = check_and_cast<DetectionPacket *>(msg);
+    int isPaired = pkt->getPaired();
+    int pairedId = pkt->getPairedId();
 
     double gamma = getParentModule()->par("gamma");
     double maximalWeight = -INFINITY;
     int maximallWeightId = -1;
+
+    //calculate the weight W_(u,w) eq. 7 page 6 for every child w:
+    //W_(u,w) = (0.5 - gamma) * E_uw + E_uv - cooperative energy.
+    //linkEnergyPerBit() always takes w = myPartnerId, so only E_uw
+    //depends on the child; the rest is evaluated once and the weights
+    //come from one batch kernel.
+    double cooperativeEnergy;
     if (isPaired == 0) //Case (a) papa has a no pair
     {
-
-        for (int i = 0; i < numHosts; ++i)
-        {
-            double weight = 0;
-            if (!childrens[i]) //if not my child, skip
-            {
-                continue;
-            }
-            //else
-            //calculate the weight W_(u,w) eq. 7 page 6.
-            //W_(u,w) = W_(child, self)
-            weight = (0.5 - gamma) * calculateEnergyConsumptionPerBit(0, i, 0, 1, 1, 1)+calculateEnergyConsumptionPerBit(0, myParentId, 0, 1, 1, 1) - calculateEnergyConsumptionPerBit(i, myParentId, 0, 2, 1, 1);
-            //weight = (0.5 - gamma) * getEnergy(i, hostId) + getEnergy(hostId, senderHost)/*TODO -otherThing() */;
-            if (weight > maximalWeight)
-            {
-                maximalWeight = weight;
-                maximallWeightId = i;
-            }
-        }
+        cooperativeEnergy = linkEnergyPerBit<2, 1>(myParentId, 0);
     }
     else // that is got dct(1,u) a paired message
     {
         myParentsPartnerId = pairedId;
-        for (int i = 0; i < numHosts; ++i)
+        double p_uw_v = linkEnergyPerBit<2, 1>(myParentId, 0); //p_{u,w}_v
+        double p_uw_t = linkEnergyPerBit<2, 1>(myParentsPartnerId, 0); //p_{u,w}_t
+        double p_uw_vt = linkEnergyPerBit<2, 2>(myParentId, myParentsPartnerId); //p_{u,w}_{v,t}
+        double temp = std::min(p_uw_v,p_uw_t);
+        cooperativeEnergy = std::min(temp,p_uw_vt);
+    }
+    double parentEnergy = linkEnergyPerBit<1, 1>(myParentId, 0);
+
+    int n = children.size();
+    childSquaredDistances.resize(n);
+    childWeights.resize(n);
+    for (int k = 0; k < n; ++k)
+        childSquaredDistances[k] = getSquaredDistanceTo(children[k]);
+    medium->getRadioModel().pairingWeights(childSquaredDistances.data(), n, 0.5 - gamma, parentEnergy, cooperativeEnergy, childWeights.data());
+    for (int k = 0; k < n; ++k)
+    {
+        if (childWeights[k] > maximalWeight)
         {
-            double weight = 0;
-            if (!childrens[i]) //if not my child, skip
-            {
-                continue;
-            }
-            //else
-            //calculate the weight W_(u,w) eq. 7 page 6.
-            //W_(u,w) = W_(child, self)
-            double p_uw_v = calculateEnergyConsumptionPerBit(i, myParentId, 0, 2, 1, 1); //p_{u,w}_v
-            double p_uw_t = calculateEnergyConsumptionPerBit(i, myParentsPartnerId, 0, 2, 1, 1); //p_{u,w}_t
-            double p_uw_vt = calculateEnergyConsumptionPerBit(i, myParentId, myParentsPartnerId, 2, 2, 1); //p_{u,w}_{v,t}
-            double temp = std::min(p_uw_v,p_uw_t);
-            temp = std::min(temp,p_uw_vt);
-            //weight = (0.5 - gamma) * calculateEnergyConsumptionPerBit(0, i, 0, 1, 1, 1);
-            weight = (0.5 - gamma) * calculateEnergyConsumptionPerBit(0, i, 0, 1, 1, 1)+calculateEnergyConsumptionPerBit(0, myParentId, 0, 1, 1, 1) - temp;
-            //weight = (0.5 - gamma) * getEnergy(i, hostId) + getEnergyToParentSISO() - calculateEnergyConsumptionPerBit(i, myParentId, 0, 2, 1, 1)  /*TODO -otherMIMOs() */;
-            if (weight > maximalWeight)
-            {
-                maximalWeight = weight;
-                maximallWeightId = i;
-            }
+            maximalWeight = childWeights[k];
+            maximallWeightId = children[k];
         }
     }
 
@@ -896,10 +703,10 @@ void Host::recvDCT(cMessage* msg)
             setPartner(w);
         }
         // for-loop send other children dct(1,w), that is I've a partner that is w
-        for (int i = 0; i < numHosts; ++i)
+        for (int i : children)
         {
 
-            if (!childrens[i] or i == w) //if not my child, skip
+            if (i == w) //not to the partner itself
             {
                 continue;
             }
@@ -915,18 +722,8 @@ void Host::recvDCT(cMessage* msg)
     else //no one of children is a good pair, that is not improving the energy costs
     {
         // for-loop send children dct(0.0), that is I don't have a partner
-        for (int i = 0; i < numHosts; ++i)
+        for (int i : children)
         {
-
-            if (!childrens[i]) //if not my child, skip
-            {
-                continue;
-            }
-            if (i == hostId)
-            {
-                continue;
-            }
-            //else
             sendDCT(i, 0, 0);
 
         }
@@ -935,42 +732,12 @@ void Host::recvDCT(cMessage* msg)
 }
 void    Host::sendPTS(int targetHost)
 {
-    double maxRange = getParentModule()->par("maxRange");
-    simtime_t _duration;
-
-    // generate packet and schedule timer when it ends
-    double hostX = hosts[targetHost]->par("x").doubleValue();
-    double hostY = hosts[targetHost]->par("y").doubleValue();
-    double dist = std::sqrt((x-hostX) * (x-hostX) + (y-hostY) * (y-hostY));
-
-
-    radioDelay = dist / propagationSpeed;
-
-    char pkname[40];
-    sprintf(pkname, "PartnerSelect-%03d-pts(%03d,%03d)", hostId, targetHost, hostId);
-
-    EV << "generating packet " << pkname << endl;
-
-    state = TRANSMIT;
-    emit(stateSignal, state);
+    LOG_AT(VERBOSITY_PACKET) << "generating packet pts(" << targetHost << "," << hostId << ")" << endl;
 
-    cPacket *pk = new cPacket(pkname);
-    char parPower[40] = {0};
-
-
-    pk->setBitLength(pkLenBits->intValue());
-    simtime_t duration = pk->getBitLength() / txRate;
-    pk->setKind(6);
-
-    sendDirect(pk, radioDelay, duration, hosts[targetHost]->gate("in"));
-
-
-    // let visualization code know about the new packet
-    if (transmissionRing != nullptr)
-    {
-        delete lastPacket;
-        lastPacket = pk->dup();
-    }
+    PartnerSelectPacket *pk = newControlPacket<PartnerSelectPacket>("PartnerSelect", PARTNER_SELECT_PACKET);
+    pk->setSenderId(hostId);
+    pk->setTargetId(targetHost);
+    sendControlPacket(pk, targetHost);
 }
 void    Host::setPartner(int targetHost)
 {
@@ -979,68 +746,29 @@ void    Host::setPartner(int targetHost)
 double  Host::getEnergy(int v, int u)
 {
     Host *host_u = check_and_cast<Host *>(hosts[u]);
-    return host_u->calculateEnergyConsumptionPerBit(0, v, 0, 1, 1, 1);;
+    return host_u->linkEnergyPerBit<1, 1>(v, 0);;
 }
 void Host::sendDCT(int targetHost, bool paired, int hostId)
 {
-    double maxRange = getParentModule()->par("maxRange");
-    simtime_t _duration;
-
-    // generate packet and schedule timer when it ends
-    double hostX = hosts[targetHost]->par("x").doubleValue();
-    double hostY = hosts[targetHost]->par("y").doubleValue();
-    double dist = std::sqrt((x-hostX) * (x-hostX) + (y-hostY) * (y-hostY));
-
-
-    radioDelay = dist / propagationSpeed;
-
-    char pkname[40];
-    sprintf(pkname, "Detection-%03d-dct(%01d,%03d)", this->hostId, paired, hostId);
-
-    EV << "generating packet " << pkname << endl;
+    LOG_AT(VERBOSITY_PACKET) << "generating packet dct(" << paired << "," << hostId << ")" << endl;
 
-    state = TRANSMIT;
-    emit(stateSignal, state);
-
-    cPacket *pk = new cPacket(pkname);
-    char parPower[40] = {0};
-
-
-    pk->setBitLength(pkLenBits->intValue());
-    simtime_t duration = pk->getBitLength() / txRate;
-    pk->setKind(5);
-
-    sendDirect(pk, radioDelay, duration, hosts[targetHost]->gate("in"));
-
-
-    // let visualization code know about the new packet
-    if (transmissionRing != nullptr)
-    {
-        delete lastPacket;
-        lastPacket = pk->dup();
-    }
+    DetectionPacket *pk = newControlPacket<DetectionPacket>("Detection", DETECTION_PACKET);
+    pk->setSenderId(this->hostId);
+    pk->setPaired(paired);
+    pk->setPairedId(hostId);
+    sendControlPacket(pk, targetHost);
 }
 void Host::recvRTD(cMessage* msg)
 {
-    const char *messageText = msg->getName();
-    int numHosts = getParentModule()->par("numHosts");
-    //RouteDiscovery-000-rtd(000,000000.10000,000000.10000)
-    //rtd(%03d,%042.20lf,%042.20lf)
-    int senderHost = 0;
-    double energyPC1 = 0; //pc1 as refered at vMER algorithm
-    double energyPC2 = INFINITY; //pc2 as refered at vMER algorithm
-    char checkInf[10] = {0};
-    sscanf(messageText, "%*4s%03d", &senderHost);
-    sscanf(messageText, "%*8s%042.38lf", &energyPC1);
-    sscanf(messageText, "%*90s%3s", &checkInf);
-    if (!strcmp(checkInf,"inf"))
-    {
-        energyPC2 = INFINITY;
-    }
-    else
-    {
-        sscanf(messageText, "%*51s%042.38lf", &energyPC2);
-    }
+    // a host that has sent its rtds drops every later one
+    if (rtdTerminated)
+        return;
+    RouteDiscoveryPacket *pkt = check_and_cast<RouteDiscoveryPacket *>(msg);
+    // the base station (and any host outside the tree) has no route to discover
+    if (this->myParentId == -1)
+        return;
+    double energyPC1 = pkt->getPc1(); //pc1 as refered at vMER algorithm
+    double energyPC2 = pkt->getPc2(); //pc2 as refered at vMER algorithm
 
     double energy_path0 = INFINITY;
     if (energyPC2 == INFINITY)
@@ -1072,10 +800,10 @@ void Host::recvRTD(cMessage* msg)
     {
         // the parent node v has partner: denoted {v, t}
         pnum--;
-        double maxRange = getParentModule()->par("maxRange");
+        double maxRange = medium->getMaxRange();
         Host* v = check_and_cast<Host *>(hosts[this->myParentId]);
         int t = v->myPartnerId;
-        if (distHosts[t] > maxRange)
+        if (t == -1 || getDistanceTo(t) > maxRange)
         {
             // node u will not receive message from v
             pnum = 0;
@@ -1116,71 +844,49 @@ void Host::recvRTD(cMessage* msg)
         // tp1 = energy of path0 TODO
         tp1 = energy_path0;
         // for-loop to send message to connected nodes
-        for (int i = 0; i < numHosts; ++i)
+        for (int e = graph->getEdgeBegin(hostId); e < graph->getEdgeEnd(hostId); ++e)
         {
 
-            if (!neighborSet[i])
+            if (!neighborKnown[e - graph->getEdgeBegin(hostId)])
+            {
+                continue;
+            }
+            if (treeScopedRouteDiscovery && !waitsForRTD(graph->getNeighborId(e)))
             {
                 continue;
             }
-            sendRTD(i, tp1,tp2);
+            sendRTD(graph->getNeighborId(e), tp1,tp2);
             rtdTerminated = 1;
             double tempMin = std::min(tp1,tp2);
 
         }
+        // a host whose rtd nobody waits for is done as well
+        if (treeScopedRouteDiscovery)
+            rtdTerminated = 1;
     }
 }
 
-void Host::sendRTD(int targetHost, double pc1, double pc2)
+bool Host::waitsForRTD(int i) const
 {
-    double maxRange = getParentModule()->par("maxRange");
-    simtime_t _duration;
-
-    // generate packet and schedule timer when it ends
-    double hostX = hosts[targetHost]->par("x").doubleValue();
-    double hostY = hosts[targetHost]->par("y").doubleValue();
-    double dist = std::sqrt((x-hostX) * (x-hostX) + (y-hostY) * (y-hostY));
-
-
-    radioDelay = dist / propagationSpeed;
-
-    char pkname[99];
-    double  energyPairedToBase;
-    /*
-    if (myPartnerId > -1)
-    {
-        energyPairedToBase = this->energyPairedToBase;
-    }
-    else
-    {
-        energyPairedToBase = INFINITY;
-    }
-    */
-    sprintf(pkname, "rtd(%03d,%042.38lf,%042.38lf)", this->hostId, pc1, pc2);
-
-
-    EV << "generating packet " << pkname << endl;
-
-    state = TRANSMIT;
-    emit(stateSignal, state);
-
-    cPacket *pk = new cPacket(pkname);
-
-
-
-    pk->setBitLength(pkLenBits->intValue());
-    simtime_t duration = pk->getBitLength() / txRate;
-    pk->setKind(7);
-
-    sendDirect(pk, radioDelay, duration, hosts[targetHost]->gate("in"));
+    // a host takes its route costs from its parent v and from v's partner
+    // t, which is one of v's children: we serve our children, and our
+    // siblings if we are t
+    if (std::binary_search(children.begin(), children.end(), i))
+        return true;
+    if (myParentId == -1 || check_and_cast<Host *>(hosts[myParentId])->myPartnerId != hostId)
+        return false;
+    return check_and_cast<Host *>(hosts[i])->myParentId == myParentId;
+}
 
+void Host::sendRTD(int targetHost, double pc1, double pc2)
+{
+    LOG_AT(VERBOSITY_PACKET) << "generating packet rtd(" << hostId << "," << pc1 << "," << pc2 << ")" << endl;
 
-    // let visualization code know about the new packet
-    if (transmissionRing != nullptr)
-    {
-        delete lastPacket;
-        lastPacket = pk->dup();
-    }
+    RouteDiscoveryPacket *pk = newControlPacket<RouteDiscoveryPacket>("rtd", ROUTE_DISCOVERY_PACKET);
+    pk->setSenderId(hostId);
+    pk->setPc1(pc1);
+    pk->setPc2(pc2);
+    sendControlPacket(pk, targetHost);
 }
 
 double Host::getPath_1_Energy(double pc1)
@@ -1255,57 +961,58 @@ double Host::getEnergyToParentSISO()
     {
        return INFINITY;
     }
-    return calculateEnergyConsumptionPerBit(0, this->myParentId, 0, 1, 1, 1);
+    return linkEnergyPerBit<1, 1>(this->myParentId, 0);
 }
 double Host::getEnergyToParentsParentSISO()
 {
     Host *v = check_and_cast<Host *>(hosts[this->myParentId]);
-    return calculateEnergyConsumptionPerBit(0, v->myParentId, 0, 1, 1, 1);
+    return linkEnergyPerBit<1, 1>(v->myParentId, 0);
 }
 double Host::getEnergyToParentsPartnerSISO()
 {
     Host *v = check_and_cast<Host *>(hosts[this->myParentId]);
     if (v->myPartnerId == -1)
         return INFINITY;
-    return calculateEnergyConsumptionPerBit(0, v->myPartnerId, 0, 1, 1, 1);
+    return linkEnergyPerBit<1, 1>(v->myPartnerId, 0);
 }
 double Host::getEnergyToPartnerSISO()
 {
     if (this->myPartnerId == -1)
         return INFINITY;
-    return calculateEnergyConsumptionPerBit(0, this->myPartnerId, 0, 1, 1, 1);
+    return linkEnergyPerBit<1, 1>(this->myPartnerId, 0);
 }
 double Host::getEnergyToParentsParentsPartnerSISO()
 {
     Host *v = check_and_cast<Host *>(hosts[this->myParentId]);
-    Host *_v = check_and_cast<Host *>(hosts[v->myParentId]);
     if (v->myPartnerId == -1)
         return INFINITY;
-    return calculateEnergyConsumptionPerBit(_v->myPartnerId, 0, 0, 1, 1, 1);
+    // the grandparent's partner used to go in the ignored first argument
+    // of calculateEnergyConsumptionPerBit(), so the receiver is host 0
+    return linkEnergyPerBit<1, 1>(0, 0);
 }
 double Host::getEnergyToParentSIMO()
 {
     Host *v = check_and_cast<Host *>(hosts[this->myParentId]);
     if (v->myPartnerId == -1)
         return INFINITY;
-    return calculateEnergyConsumptionPerBit(0 ,this->myParentId, v->myPartnerId, 1, 2, 1);
+    return linkEnergyPerBit<1, 2>(this->myParentId, v->myPartnerId);
 }
 double Host::getEnergyToParentMISO()
 {
-    return calculateEnergyConsumptionPerBit(this->myPartnerId, this->myParentId, 0, 2, 1, 1);
+    return linkEnergyPerBit<2, 1>(this->myParentId, 0);
 }
 double Host::getEnergyToParentsPartnerMISO()
 {
     Host *v = check_and_cast<Host *>(hosts[this->myParentId]);
     if (v->myPartnerId == -1)
         return INFINITY;
-    return calculateEnergyConsumptionPerBit(this->myPartnerId, 0,v->myPartnerId, 2, 1, 1);
+    return linkEnergyPerBit<2, 1>(0, v->myPartnerId);
 }
 double Host::getEnergyToParentMIMO()
 {
     Host *v = check_and_cast<Host *>(hosts[this->myParentId]);
     if (v->myPartnerId == -1)
         return INFINITY;
-    return calculateEnergyConsumptionPerBit(this->myPartnerId, this->myParentId, v->myPartnerId, 2, 2, 1);
+    return linkEnergyPerBit<2, 2>(this->myParentId, v->myPartnerId);
 }
 }; //namespace
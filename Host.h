@@ -10,8 +10,14 @@
 #ifndef __ALOHA_HOST_H_
 #define __ALOHA_HOST_H_
 #define PI 3.14159265359
+#include <algorithm>
 #include <omnetpp.h>
 
+#include "ControlPackets_m.h"
+#include "Diagnostics.h"
+#include "PhaseCoordinator.h"
+#include "RadioMedium.h"
+
 using namespace omnetpp;
 
 namespace aloha {
@@ -21,9 +27,6 @@ namespace aloha {
  */
 class Host : public cSimpleModule
 {
-public:
-    double  *distHosts;
-
   private:
     // routing parameters
     enum { SISO = 0, SIMO = 1, MISO = 2, MIMO = 3 } modeTxRx;
@@ -35,17 +38,40 @@ public:
     cPar *pkLenBits;
     simtime_t slotTime;
     bool isSlotted;
+    bool headless;      // no animation, display strings, watches or state signal
+    int verbosity;      // see Diagnostics.h
     cDoubleHistogram totalEnergyStats;
 
 
     // state variables, event pointers etc
     //cModule *server;
     cModule **hosts;
-
-
-    cMessage *endTxEvent;
+    RadioMedium *medium = nullptr;    // shared radio model of the network
+    PhaseCoordinator *coordinator = nullptr;  // starts our phases, counts our packets
+    const NeighborGraph *graph = nullptr; // shared in-range links, row hostId is ours
+    EnergyTable *energyTable = nullptr;   // shared link energies, nullptr to compute them
+
+    // self-messages, allocated once and rescheduled; the kind of a phase
+    // timer is its PhaseCoordinator::Phase
+    enum TimerKind {
+        ADVERTISE_TIMER = PhaseCoordinator::NUM_PHASES,
+        NUM_TIMER_KINDS
+    };
+    cMessage *phaseTimers[PhaseCoordinator::NUM_PHASES] = {};
+
+    // handleMessage() dispatch, by timer kind and by control packet kind
+    typedef void (Host::*TimerHandler)();
+    typedef void (Host::*PacketHandler)(cMessage *msg);
+    static const TimerHandler timerHandlers[NUM_TIMER_KINDS];
+    static const PacketHandler packetHandlers[PhaseCoordinator::NUM_PACKET_KINDS];
     enum { IDLE = 0, TRANSMIT = 1 } state;
     simsignal_t stateSignal;
+    simsignal_t packetSentSignal;
+    simsignal_t packetReceivedSignal;
+    simsignal_t bitsSentSignal;
+    simsignal_t bellmanFordRelaxationSignal;
+    simsignal_t handlerTimeSignal;
+    bool profileHandlers = false;
     int pkCounter;
 
     // position on the canvas, unit is m
@@ -67,12 +93,20 @@ public:
     mutable std::vector<cOvalFigure *> transmissionCircles; // ripples inside the packet ring
     //algorithms
 
-    double  *shortestPath;
     double  shortestPathDistance;
-    int     *throughPath;
-    double *energyHosts;
-    bool *neighborSet;
-    bool *childrens;
+    int     shortestPathVia = -1;       // neighbor that advertised shortestPathDistance
+    bool    orderedRelaxation = false;  // treeProtocol "ordered": advertise after a cost-proportional delay
+    double  relaxationDelayPerCost = 0; // s per m^2 of path cost
+    bool    treeScopedRouteDiscovery = false;   // routeDiscoveryScope "tree"
+    cMessage *advertiseTimer = nullptr; // pending advertisement of shortestPathDistance
+
+    // received control packets kept for reuse by our own sends, by kind;
+    // at most one broadcast's worth (degree + 1) per kind
+    std::vector<cPacket *> packetPool[PhaseCoordinator::NUM_PACKET_KINDS];
+    size_t maxPooledPackets = 0;
+    std::vector<bool> neighborKnown;    // per edge of our graph row: location received
+    std::vector<int> children;          // in increasing id order
+    std::vector<double> childSquaredDistances, childWeights;  // per child, scratch of recvDCT
     double totalEnergy = 0;
     double totalEnergyMTD = 0;
 
@@ -89,18 +123,43 @@ public:
     bool    rtdTerminated = 0;
 
     void gotBellmanFord(omnetpp::cMessage* msg);
+    void restoreTree(const TreeSnapshot& tree);
     void initTxProcess();
     void initBellmanFordProcess();
     void initFamilyProcess();
     void calculateRadioDelay(int i);
     void initDetectionPhase();
     void init_vMER_algo();
+    void initEnergyProcess();
+    void initEnergyMTDProcess();
+    void printTotalEnergy();
     void handleLocationMessage(omnetpp::cMessage* msg);
     void handleBellmanFordMessage(omnetpp::cMessage* msg);
+    void advertiseShortestPath();
+    void scheduleAdvertisement();
     void sendEnergy(double energy);
     void sendEnergyMTD(double energy);
+    void sendControlPacket(cPacket *pk, int targetHost);
+    template<typename T> T *newControlPacket(const char *name, short kind);
+    void recycleControlPacket(cPacket *pk);
 
   public:
+    /**
+     * Called by the PhaseCoordinator: schedules the timer of the given
+     * PhaseCoordinator::Phase for the current simulation time.
+     */
+    void startPhase(int phase);
+
+    int getHostId() const { return hostId; }
+    int getParentId() const { return myParentId; }
+    int getPartnerId() const { return myPartnerId; }
+    double getTotalEnergy() const { return totalEnergy; }
+    double getTotalEnergyMTD() const { return totalEnergyMTD; }
+    double getReportEnergy() const { return std::min(tp1, tp2); }   // per bit, charged by the vMER convergecast
+    double getReportEnergyMTD() { return getEnergyToParentSISO(); } // by the MTD one
+    double getDistanceTo(int j) const { return graph->getDistance(hostId, j); }
+    double getSquaredDistanceTo(int j) const { return graph->getSquaredDistance(hostId, j); }
+
     double getEnergyToParentSISO();
     double getEnergyToParentsParentSISO();
     double getEnergyToParentsPartnerSISO();
@@ -116,8 +175,10 @@ public:
     virtual ~Host();
 
   protected:
-    virtual void    initialize() override;
+    virtual int     numInitStages() const override { return 2; }
+    virtual void    initialize(int stage) override;
     virtual void    handleMessage(cMessage *msg) override;
+    virtual void    finish() override;
     virtual void    refreshDisplay() const override;
     void            sendDCT(int targetHost, bool paired, int hostId);   // detection message
     void            sendPTS(int targetHost);                            // partner-selection message
@@ -127,6 +188,7 @@ public:
     void            recvDCT(cMessage* msg);
     void            recvPTS(cMessage* msg);
     void            recvRTD(cMessage* msg);
+    bool            waitsForRTD(int i) const;
     void            recvEnergy(cMessage* msg);
     void            recvEnergyMTD(cMessage* msg);
     double          getEnergy(int v, int u);
@@ -141,6 +203,8 @@ public:
     double          getPath_8_Energy(double pc2); // path8 = u --> {u, w} --> {v, t} --> ... --> z
 
     double calculateEnergyConsumptionPerBit(int _v, int _w, int _t, int numTx, int numRx ,int bitsCount);
+    template<int NumTx, int NumRx>
+    double linkEnergyPerBit(int v, int t);  // the same for a mode fixed at compile time
 
     simtime_t getNextTransmissionTime();
 };
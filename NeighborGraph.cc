@@ -0,0 +1,153 @@
+//
+// This file is part of an OMNeT++/OMNEST simulation example.
+//
+// Copyright (C) 1992-2015 Andras Varga
+//
+// This file is distributed WITHOUT ANY WARRANTY. See the file
+// `license' for details on this and other legal matters.
+//
+
+#include <algorithm>
+#include <utility>
+
+#include "NeighborGraph.h"
+
+namespace aloha {
+
+void NeighborGraph::build(const std::vector<double>& x, const std::vector<double>& y, const SpatialGrid& grid, double range)
+{
+    int n = x.size();
+    rowStart.assign(n + 1, 0);
+    neighborIds.clear();
+    distances.clear();
+    squaredDistances.clear();
+    for (int i = 0; i < n; ++i)
+    {
+        grid.queryNeighbors(i, range, neighborIds);
+        rowStart[i + 1] = neighborIds.size();
+    }
+    neighborIds.shrink_to_fit();
+    distances.resize(neighborIds.size());
+    squaredDistances.resize(neighborIds.size());
+    for (int i = 0; i < n; ++i)
+    {
+        for (int e = rowStart[i]; e < rowStart[i + 1]; ++e)
+        {
+            int j = neighborIds[e];
+            double dx = x[i] - x[j], dy = y[i] - y[j];
+            distances[e] = std::sqrt(dx * dx + dy * dy);
+            squaredDistances[e] = distances[e] * distances[e];
+        }
+    }
+}
+
+void NeighborGraph::update(const std::vector<int>& nodes, const std::vector<double>& x, const std::vector<double>& y,
+        const std::vector<bool>& alive, const SpatialGrid& grid, double range, std::vector<int>& changed)
+{
+    int n = getNumNodes();
+    std::vector<int> rowOf(n, -1);      // index into nodes of an updated node
+    std::vector<bool> touched(n, false);
+    std::vector<std::vector<int>> newRows(nodes.size());
+    for (int k = 0; k < (int)nodes.size(); ++k)
+        rowOf[nodes[k]] = k;
+    for (int k = 0; k < (int)nodes.size(); ++k)
+    {
+        int i = nodes[k];
+        touched[i] = true;
+        for (int e = rowStart[i]; e < rowStart[i + 1]; ++e)
+            touched[neighborIds[e]] = true;
+        if (alive[i])
+            grid.queryNeighbors(i, range, newRows[k]);
+    }
+
+    // rows of other nodes gain the updated nodes that are now in range
+    std::vector<std::pair<int, int>> additions;
+    for (int k = 0; k < (int)nodes.size(); ++k)
+    {
+        for (int j : newRows[k])
+        {
+            touched[j] = true;
+            if (rowOf[j] == -1)
+                additions.push_back(std::make_pair(j, nodes[k]));
+        }
+    }
+    std::sort(additions.begin(), additions.end());
+
+    std::vector<int> newRowStart(n + 1, 0);
+    std::vector<int> newNeighborIds;
+    std::vector<double> newDistances, newSquaredDistances;
+    newNeighborIds.reserve(neighborIds.size());
+    newDistances.reserve(neighborIds.size());
+    newSquaredDistances.reserve(neighborIds.size());
+    auto add = [&](int i, int j) {
+        double dx = x[i] - x[j], dy = y[i] - y[j];
+        double d = std::sqrt(dx * dx + dy * dy);
+        newNeighborIds.push_back(j);
+        newDistances.push_back(d);
+        newSquaredDistances.push_back(d * d);
+    };
+    auto next = additions.begin();
+    for (int i = 0; i < n; ++i)
+    {
+        if (!touched[i])
+        {
+            newNeighborIds.insert(newNeighborIds.end(), neighborIds.begin() + rowStart[i], neighborIds.begin() + rowStart[i + 1]);
+            newDistances.insert(newDistances.end(), distances.begin() + rowStart[i], distances.begin() + rowStart[i + 1]);
+            newSquaredDistances.insert(newSquaredDistances.end(), squaredDistances.begin() + rowStart[i], squaredDistances.begin() + rowStart[i + 1]);
+        }
+        else if (rowOf[i] != -1)
+        {
+            for (int j : newRows[rowOf[i]])
+                add(i, j);
+        }
+        else
+        {
+            // merge the kept entries with the added ones, both in id order
+            int e = rowStart[i];
+            while (e < rowStart[i + 1] || (next != additions.end() && next->first == i))
+            {
+                if (e < rowStart[i + 1] && rowOf[neighborIds[e]] != -1)
+                {
+                    e++;    // updated node: kept only if it is among the additions
+                }
+                else if (e < rowStart[i + 1] && (next == additions.end() || next->first != i || neighborIds[e] < next->second))
+                {
+                    newNeighborIds.push_back(neighborIds[e]);
+                    newDistances.push_back(distances[e]);
+                    newSquaredDistances.push_back(squaredDistances[e]);
+                    e++;
+                }
+                else
+                {
+                    add(i, next->second);
+                    ++next;
+                }
+            }
+        }
+        newRowStart[i + 1] = newNeighborIds.size();
+        if (touched[i])
+            changed.push_back(i);
+    }
+    rowStart.swap(newRowStart);
+    neighborIds.swap(newNeighborIds);
+    distances.swap(newDistances);
+    squaredDistances.swap(newSquaredDistances);
+}
+
+int NeighborGraph::findEdge(int i, int j) const
+{
+    auto first = neighborIds.begin() + rowStart[i];
+    auto last = neighborIds.begin() + rowStart[i + 1];
+    auto it = std::lower_bound(first, last, j);
+    if (it == last || *it != j)
+        return -1;
+    return it - neighborIds.begin();
+}
+
+size_t NeighborGraph::getMemoryUsage() const
+{
+    return rowStart.capacity() * sizeof(int) + neighborIds.capacity() * sizeof(int)
+            + distances.capacity() * sizeof(double) + squaredDistances.capacity() * sizeof(double);
+}
+
+}; //namespace
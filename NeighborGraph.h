@@ -0,0 +1,88 @@
+//
+// This file is part of an OMNeT++/OMNEST simulation example.
+//
+// Copyright (C) 1992-2015 Andras Varga
+//
+// This file is distributed WITHOUT ANY WARRANTY. See the file
+// `license' for details on this and other legal matters.
+//
+
+#ifndef __ALOHA_NEIGHBORGRAPH_H_
+#define __ALOHA_NEIGHBORGRAPH_H_
+
+#include <cmath>
+#include <vector>
+
+#include "SpatialGrid.h"
+
+namespace aloha {
+
+/**
+ * In-range neighbor relation of the hosts in compressed sparse row form.
+ * Row i holds the neighbors of host i in increasing id order, together
+ * with their distances and squared distances; pairs that are out of range
+ * are not stored and read back as INFINITY.
+ */
+class NeighborGraph
+{
+  public:
+    NeighborGraph() {}
+
+    /**
+     * Builds the graph of all pairs within range, using the grid to find them.
+     */
+    void build(const std::vector<double>& x, const std::vector<double>& y, const SpatialGrid& grid, double range);
+
+    /**
+     * Brings the graph up to date after the given nodes moved or failed:
+     * their rows are queried again from the grid, which must already hold
+     * the new positions (failed nodes left out of it), and the
+     * rows of their old and new neighbors are patched. Other rows are
+     * copied over unchanged, without recomputing any distance. Every node
+     * whose row changed is appended to changed.
+     */
+    void update(const std::vector<int>& nodes, const std::vector<double>& x, const std::vector<double>& y,
+            const std::vector<bool>& alive, const SpatialGrid& grid, double range, std::vector<int>& changed);
+
+    int getNumNodes() const { return (int)rowStart.size() - 1; }
+    int getNumEdges() const { return neighborIds.size(); }
+
+    // edges of node i are the indices [getEdgeBegin(i), getEdgeEnd(i))
+    int getEdgeBegin(int i) const { return rowStart[i]; }
+    int getEdgeEnd(int i) const { return rowStart[i + 1]; }
+    int getDegree(int i) const { return rowStart[i + 1] - rowStart[i]; }
+    int getNeighborId(int e) const { return neighborIds[e]; }
+    double getEdgeDistance(int e) const { return distances[e]; }
+    double getEdgeSquaredDistance(int e) const { return squaredDistances[e]; }
+
+    /**
+     * Returns the edge index of (i, j), or -1 if j is not a neighbor of i.
+     */
+    int findEdge(int i, int j) const;
+
+    double getDistance(int i, int j) const
+    {
+        int e = findEdge(i, j);
+        return e == -1 ? INFINITY : distances[e];
+    }
+    double getSquaredDistance(int i, int j) const
+    {
+        int e = findEdge(i, j);
+        return e == -1 ? INFINITY : squaredDistances[e];
+    }
+
+    /**
+     * Approximate heap memory held by the graph, in bytes.
+     */
+    size_t getMemoryUsage() const;
+
+  private:
+    std::vector<int> rowStart;             // size numNodes+1
+    std::vector<int> neighborIds;          // size numEdges
+    std::vector<double> distances;         // size numEdges, in m
+    std::vector<double> squaredDistances;  // size numEdges, in m^2
+};
+
+}; //namespace
+
+#endif
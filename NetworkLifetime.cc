@@ -0,0 +1,151 @@
+//
+// This file is part of an OMNeT++/OMNEST simulation example.
+//
+// Copyright (C) 1992-2015 Andras Varga
+//
+// This file is distributed WITHOUT ANY WARRANTY. See the file
+// `license' for details on this and other legal matters.
+//
+
+#include <algorithm>
+#include <cmath>
+
+#include "NetworkLifetime.h"
+
+using namespace std;
+
+namespace aloha {
+
+NetworkLifetime::NetworkLifetime(const std::vector<double>& x, const std::vector<double>& y, const NeighborGraph& graph,
+        const RadioModel& radioModel, double maxRange, int baseStationId, double gamma, Scheme scheme,
+        const Parameters& params) :
+    x(x), y(y), graph(graph), solver(this->graph, radioModel, maxRange, baseStationId, gamma), radioModel(radioModel),
+    maxRange(maxRange), baseStationId(baseStationId), scheme(scheme), params(params)
+{
+    int n = x.size();
+    alive.assign(n, true);
+    residual.assign(n, params.batteryCapacity);
+    residual[baseStationId] = INFINITY;
+    drain.assign(n, 0);
+}
+
+void NetworkLifetime::plan()
+{
+    // the links each host sends over to its parent, and their energy
+    int n = x.size();
+    std::vector<int> parent(n);
+    std::vector<double> energyPerBit(n, INFINITY);
+    auto d2 = [this](int a, int b) { return (a == -1 || b == -1) ? INFINITY : graph.getSquaredDistance(a, b); };
+    int fallbacks = 0, cooperative = 0;
+    numLinks.assign(n, 0);
+    links.resize(2 * n);
+    for (int i = 0; i < n; ++i)
+    {
+        parent[i] = solver.getParentId(i);
+        VmerSolver::Link *hop = &links[2 * i];
+        if (scheme == VMER)
+            numLinks[i] = solver.getReportLinks(i, hop);
+        if (numLinks[i] == 0 && parent[i] != -1 && solver.getReportEnergyMTD(i) < INFINITY)
+        {
+            if (scheme == VMER)
+                fallbacks++;
+            hop[0] = {1, 1, i, solver.getPartnerId(i), parent[i], 0};
+            numLinks[i] = 1;
+        }
+        else if (numLinks[i] > 1 || (numLinks[i] == 1 && hop[0].numTx * hop[0].numRx > 1))
+        {
+            cooperative++;
+        }
+        if (numLinks[i] > 0)
+            energyPerBit[i] = 0;
+        for (int k = 0; k < numLinks[i]; ++k)
+            energyPerBit[i] += energyPerBitOfMode(radioModel, hop[k].numTx, hop[k].numRx, d2, hop[k].u, hop[k].w, hop[k].v, hop[k].t);
+    }
+    if (numRebuilds == 0)
+    {
+        numFallbackHosts = fallbacks;
+        numCooperativeHosts = cooperative;
+    }
+
+    // one round with the expected payload stands for every round
+    DataGathering::Parameters gathering = params.gathering;
+    gathering.payloadBits *= std::min(1.0, std::max(0.0, gathering.reportProbability));
+    gathering.reportProbability = 1;
+    DataGathering round(parent, energyPerBit, baseStationId, gathering, 0);
+    round.runRound();
+    if (halfLostRound == -1 && 2 * (n - 1 - round.getNumSenders()) >= n - 1)
+        halfLostRound = numRounds;
+
+    // every antenna of a link pays its share of every bit sent over it
+    std::fill(drain.begin(), drain.end(), 0);
+    for (int i = 0; i < n; ++i)
+    {
+        double bits = round.getHostSentBits(i);
+        if (bits == 0)
+            continue;
+        auto charge = [this, bits](int host, double energy) { drain[host] += bits * energy; };
+        for (int k = 0; k < numLinks[i]; ++k)
+        {
+            const VmerSolver::Link& link = links[2 * i + k];
+            chargeAntennasOfMode(radioModel, link.numTx, link.numRx, d2, link.u, link.w, link.v, link.t, charge);
+        }
+    }
+    drain[baseStationId] = 0;
+}
+
+void NetworkLifetime::run()
+{
+    int n = x.size();
+    solver.solve();
+    grid.build(x, y, maxRange, &alive);
+    plan();
+    std::vector<int> dying, changed;
+    while (numRounds < params.maxRounds && 2 * numDead < n - 1)
+    {
+        // the hosts with the fewest whole rounds left die in the round after
+        long roundsLeft = params.maxRounds - numRounds;
+        bool draining = false;
+        for (int i = 0; i < n; ++i)
+        {
+            if (!alive[i] || drain[i] <= 0)
+                continue;
+            draining = true;
+            roundsLeft = std::min(roundsLeft, (long)std::min(std::floor(residual[i] / drain[i]), 1e18));
+        }
+        if (!draining)
+            break;  // nobody can reach the base station any more
+        dying.clear();
+        for (int i = 0; i < n; ++i)
+        {
+            if (!alive[i] || drain[i] <= 0)
+                continue;
+            residual[i] = std::max(0.0, residual[i] - roundsLeft * drain[i]);
+            if (residual[i] < drain[i])
+                dying.push_back(i);
+        }
+        numRounds += roundsLeft;
+        if (dying.empty())
+            break;  // maxRounds
+
+        if (firstDeathRound == -1)
+            firstDeathRound = numRounds;
+        for (int i : dying)
+            alive[i] = false;
+        numDead += dying.size();
+        if (2 * numDead >= n - 1)
+        {
+            halfDeadRound = numRounds;
+            break;
+        }
+
+        // re-plan without the dead hosts
+        grid.update(dying, &alive);
+        changed.clear();
+        graph.update(dying, x, y, alive, grid, maxRange, changed);
+        solver.update(dying, changed);
+        numRebuilds++;
+        plan();
+    }
+}
+
+}; //namespace
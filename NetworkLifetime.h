@@ -0,0 +1,124 @@
+//
+// This file is part of an OMNeT++/OMNEST simulation example.
+//
+// Copyright (C) 1992-2015 Andras Varga
+//
+// This file is distributed WITHOUT ANY WARRANTY. See the file
+// `license' for details on this and other legal matters.
+//
+
+#ifndef __ALOHA_NETWORKLIFETIME_H_
+#define __ALOHA_NETWORKLIFETIME_H_
+
+#include <vector>
+
+#include "DataGathering.h"
+#include "NeighborGraph.h"
+#include "RadioModel.h"
+#include "SpatialGrid.h"
+#include "VmerSolver.h"
+
+namespace aloha {
+
+/**
+ * Lifetime of a network whose hosts run on batteries: data-gathering
+ * rounds (see DataGathering) drain every host, and whenever hosts die the
+ * tree and the pairing are re-planned around them (VmerSolver::update())
+ * until half of the hosts are dead.
+ *
+ * Between two deaths every round drains every host by the same amount, so
+ * the rounds are not run one by one: the next host to die is the one with
+ * the fewest whole rounds left in its battery, and all others are advanced
+ * past those rounds in one step. A run therefore costs one re-plan per
+ * death event, whatever the number of rounds.
+ *
+ * Every bit a host sends goes over the links of its hop to the parent:
+ * under MTD the SISO link, under vMER those of the path term it chose
+ * (VmerSolver::getReportLinks()), e.g. the SISO link to its partner and
+ * the MIMO link from both to the parent and its partner. Each antenna of
+ * a link pays its own share of the link energy
+ * (RadioModel::getTransmitEnergy()), so a partner pays for the
+ * cooperative transmissions it takes part in. Hosts without a finite vMER
+ * cost (no usable route was discovered) send over the MTD link instead;
+ * getNumFallbackHosts() counts them and getNumCooperativeHosts() the
+ * hosts whose vMER hop is not the plain SISO link, so that a comparison
+ * in which vMER hardly differs from MTD shows. With reportProbability
+ * below 1 the expected payload is sent every round. The base station is
+ * mains-powered.
+ */
+class NetworkLifetime
+{
+  public:
+    enum Scheme { VMER, MTD };
+
+    struct Parameters
+    {
+        double batteryCapacity = 1;     // J per host
+        DataGathering::Parameters gathering;
+        long maxRounds = 1000000000;    // the run stops here if half the hosts are still alive
+    };
+
+    /**
+     * The graph is copied, as deaths change it.
+     */
+    NetworkLifetime(const std::vector<double>& x, const std::vector<double>& y, const NeighborGraph& graph,
+            const RadioModel& radioModel, double maxRange, int baseStationId, double gamma, Scheme scheme,
+            const Parameters& params);
+
+    void setTiming(const VmerSolver::Timing& timing) { solver.setTiming(timing); }
+    void setTreeScopedRouteDiscovery(bool treeScoped) { solver.setTreeScopedRouteDiscovery(treeScoped); }
+
+    /**
+     * Runs rounds until half of the hosts (other than the base station)
+     * are dead, no host reaches the base station any more, or maxRounds
+     * is reached. Deaths near the base station can cut off hosts that
+     * still have energy, so besides the round at which half of the hosts
+     * are dead, the round at which half of them are dead or cut off is
+     * recorded.
+     */
+    void run();
+
+    // in completed rounds; -1 if it did not happen
+    long getFirstDeathRound() const { return firstDeathRound; }
+    long getHalfDeadRound() const { return halfDeadRound; }
+    long getHalfLostRound() const { return halfLostRound; }        // half dead or cut off
+    long getNumRounds() const { return numRounds; }
+    int getNumDead() const { return numDead; }
+    int getNumRebuilds() const { return numRebuilds; }
+    // in the initial plan, vMER only
+    int getNumFallbackHosts() const { return numFallbackHosts; }
+    int getNumCooperativeHosts() const { return numCooperativeHosts; }
+    double getResidualEnergy(int i) const { return residual[i]; }   // J
+
+  private:
+    std::vector<double> x, y;
+    NeighborGraph graph;        // before solver, which refers to it
+    VmerSolver solver;
+    const RadioModel& radioModel;
+    double maxRange;
+    int baseStationId;
+    Scheme scheme;
+    Parameters params;
+    SpatialGrid grid;
+
+    std::vector<bool> alive;
+    std::vector<double> residual;
+    std::vector<double> drain;  // J per round under the current plan
+    std::vector<int> numLinks;  // of the hop of each host, whose links are
+    std::vector<VmerSolver::Link> links;    // links[2*i], links[2*i+1]
+    long numRounds = 0;
+    long firstDeathRound = -1;
+    long halfDeadRound = -1;
+    long halfLostRound = -1;
+    int numDead = 0;
+    int numRebuilds = 0;
+    int numFallbackHosts = 0;
+    int numCooperativeHosts = 0;
+
+    // per-round drain of every host on the solver's current tree
+    void plan();
+};
+
+}; //namespace
+
+#endif
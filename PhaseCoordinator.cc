@@ -0,0 +1,538 @@
+//
+// This file is part of an OMNeT++/OMNEST simulation example.
+//
+// Copyright (C) 1992-2015 Andras Varga
+//
+// This file is distributed WITHOUT ANY WARRANTY. See the file
+// `license' for details on this and other legal matters.
+//
+
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include "PhaseCoordinator.h"
+#include "Host.h"
+
+using namespace std;
+
+namespace aloha {
+
+Define_Module(PhaseCoordinator);
+
+// name of the phase, and of the host timer that starts it
+static const char *phaseNames[] = {
+    "initTx", "initBellmanFord", "initFamily", "initDetection", "init_vMER", "initEnergy", "initEnergyMTD", "printTotalEnergy"
+};
+
+// scalar names of the control packet kinds, indexed by kind
+static const char *packetKindNames[] = {
+    nullptr, nullptr, "location", "bellmanFord", "parent", "detection", "partnerSelect", "routeDiscovery", "energy", "energyMTD"
+};
+
+static_assert((int)RunRecord::NUM_PHASES == (int)PhaseCoordinator::NUM_PHASES, "RunRecord has one packet count per phase");
+
+// phases that only the base station starts; the others start at every host
+static const bool baseStationOnly[] = {
+    false, true, false, true, true, false, false, true
+};
+
+PhaseCoordinator::~PhaseCoordinator()
+{
+    cancelAndDelete(nextPhaseEvent);
+    if (trace != nullptr)
+        fclose(trace);
+}
+
+const char *PhaseCoordinator::getPhaseName(int phase)
+{
+    return phase >= 0 && phase < NUM_PHASES ? phaseNames[phase] : "none";
+}
+
+void PhaseCoordinator::initialize()
+{
+    // hosts call the coordinator, the medium and each other directly;
+    // see "Parallel simulation" in README.txt
+    if (getEnvir()->getParsimNumPartitions() > 1)
+        throw cRuntimeError("VirtualMIMO cannot be partitioned for parallel simulation (%d partitions configured): "
+                "hosts share state through direct method calls; use mode=\"solve\" for large networks",
+                getEnvir()->getParsimNumPartitions());
+    phaseGap = par("phaseGap");
+    const char *modeName = par("mode");
+    if (strcmp(modeName, "simulate") == 0)
+        mode = SIMULATE;
+    else if (strcmp(modeName, "solve") == 0)
+        mode = SOLVE;
+    else if (strcmp(modeName, "crosscheck") == 0)
+        mode = CROSSCHECK;
+    else
+        throw cRuntimeError("Unknown mode \"%s\", expected simulate, solve or crosscheck", modeName);
+    crossCheckTolerance = par("crossCheckTolerance");
+    profileHandlers = par("profileHandlers");
+    const char *traceFile = par("traceFile");
+    if (traceFile[0] != '\0')
+    {
+        trace = fopen(traceFile, "w");
+        if (trace == nullptr)
+            throw cRuntimeError("Cannot open trace file \"%s\"", traceFile);
+        setvbuf(trace, nullptr, _IOFBF, 1 << 20);
+        fprintf(trace, "# t phase event host peer kind bits handlerTime\n");
+    }
+    cModule *network = getParentModule();
+    baseStationId = network->par("baseStationId");
+    int numHosts = network->par("numHosts");
+    hosts.resize(numHosts);
+    for (int i = 0; i < numHosts; ++i)
+        hosts[i] = check_and_cast<Host *>(network->getSubmodule("host", i));
+
+    // hosts that restored a recorded tree skip the tree-building phases
+    medium = check_and_cast<RadioMedium *>(network->getSubmodule("radioMedium"));
+    treeRestored = medium->getTreeSnapshot() != nullptr;
+
+    for (int i = 0; i < NUM_PHASES; ++i)
+        phaseStartTime[i] = -1;
+    WATCH(phase);
+    WATCH(outstanding);
+
+    nextPhaseEvent = new cMessage("nextPhase");
+    if (mode == SOLVE)
+        solve();
+    else
+        scheduleAt(simTime(), nextPhaseEvent);
+}
+
+void PhaseCoordinator::handleMessage(cMessage *msg)
+{
+    ASSERT(msg == nextPhaseEvent);
+    int next = phase + 1;
+    if (treeRestored && next <= FAMILY)
+        next = DETECTION;
+    startPhase(next);
+}
+
+void PhaseCoordinator::startPhase(int phase)
+{
+    this->phase = phase;
+    phaseStartTime[phase] = simTime();
+    phaseWallStart[phase] = Clock::now();
+    phaseFirstEvent[phase] = getSimulation()->getEventNumber();
+    EV << "Starting phase " << getPhaseName(phase) << " at t=" << simTime() << endl;
+
+    if (baseStationOnly[phase])
+    {
+        hosts[baseStationId]->startPhase(phase);
+    }
+    else
+    {
+        for (Host *host : hosts)
+            host->startPhase(phase);
+    }
+
+    // nothing to wait for (e.g. an empty network)
+    if (outstanding == 0 && phase < NUM_PHASES - 1)
+        scheduleAt(simTime() + phaseGap, nextPhaseEvent);
+}
+
+void PhaseCoordinator::packetSent(int kind, int64_t bits, int sender, int target)
+{
+    outstanding++;
+    if (phase < 0)
+        return;
+    PhaseCounters& c = counters[phase];
+    c.packets++;
+    if (kind >= 0 && kind < NUM_PACKET_KINDS)
+        c.sent[kind]++;
+    c.bitsSent += bits;
+    if (trace != nullptr)
+        fprintf(trace, "%.12g %s S %d %d %d %" PRId64 " -\n", simTime().dbl(), phaseNames[phase], sender, target, kind, bits);
+}
+
+void PhaseCoordinator::messageHandled(int kind, int host, int sender, double handlerTime)
+{
+    if (phase < 0)
+        return;
+    PhaseCounters& c = counters[phase];
+    if (kind > 0 && kind < NUM_PACKET_KINDS)
+        c.received[kind]++;
+    c.handlerTime += handlerTime;
+    if (trace != nullptr)
+        fprintf(trace, "%.12g %s R %d %d %d - %.3g\n", simTime().dbl(), phaseNames[phase], host, sender, kind, handlerTime);
+}
+
+void PhaseCoordinator::activityFinished()
+{
+    if (--outstanding == 0 && phase < NUM_PHASES - 1)
+    {
+        Enter_Method_Silent();
+        scheduleAt(simTime() + phaseGap, nextPhaseEvent);
+    }
+}
+
+VmerSolver::Timing PhaseCoordinator::getSolverTiming()
+{
+    // replay packets with the same arrival times as sendDirect() in Host
+    VmerSolver::Timing timing;
+    timing.toTicks = [](double t) { return SimTime(t).raw(); };
+    if (!hosts.empty())
+        timing.packetDurationTicks = SimTime(hosts[0]->par("pkLenBits").intValue() / hosts[0]->par("txRate").doubleValue()).raw();
+    return timing;
+}
+
+bool PhaseCoordinator::isTreeScopedRouteDiscovery()
+{
+    // the hosts have checked the value
+    return strcmp(getParentModule()->par("routeDiscoveryScope").stringValue(), "tree") == 0;
+}
+
+void PhaseCoordinator::runSolver(VmerSolver& solver)
+{
+    solver.setTiming(getSolverTiming());
+    solver.setTreeScopedRouteDiscovery(isTreeScopedRouteDiscovery());
+
+    const TreeSnapshot *tree = medium->getTreeSnapshot();
+    if (tree != nullptr)
+        solver.setTree(tree->parent, tree->shortestPathDistance);
+    solver.solve();
+}
+
+void PhaseCoordinator::solve()
+{
+    cModule *network = getParentModule();
+    Clock::time_point start = Clock::now();
+    // topology epochs change the graph, so they get a copy of the shared one
+    int topologyEpochs = par("topologyEpochs");
+    NeighborGraph graph;
+    if (topologyEpochs > 0)
+        graph = medium->getNeighborGraph();
+    VmerSolver solver(topologyEpochs > 0 ? graph : medium->getNeighborGraph(), medium->getRadioModel(), medium->getMaxRange(), baseStationId, network->par("gamma").doubleValue());
+    runSolver(solver);
+    solverWallTime = std::chrono::duration<double>(Clock::now() - start).count();
+    EV << "Solved " << solver.getNumHosts() << " hosts without simulating, " << solver.getNumPacketsReplayed() << " packets replayed" << endl;
+
+    // leave the tree for later runs with the same placement, as Host::finish() would
+    if (!treeRestored)
+        for (int i = 0; i < solver.getNumHosts(); ++i)
+            medium->recordTreeState(i, solver.getParentId(i), solver.getShortestPathDistance(i));
+
+    // same output as the printTotalEnergy phase of the base station
+    cout << solver.getTotalEnergy() << endl;
+    cout << solver.getTotalEnergyMTD() << endl;
+    emit(registerSignal("mtd_calc"), solver.getTotalEnergyMTD());
+    emit(registerSignal("mimo_calc"), solver.getTotalEnergy());
+
+    result.complete = 1;
+    result.totalEnergy = solver.getTotalEnergy();
+    result.totalEnergyMTD = solver.getTotalEnergyMTD();
+    result.packetsReplayed = solver.getNumPacketsReplayed();
+    std::vector<int> parent(solver.getNumHosts()), partner(solver.getNumHosts());
+    for (int i = 0; i < solver.getNumHosts(); ++i)
+    {
+        parent[i] = solver.getParentId(i);
+        partner[i] = solver.getPartnerId(i);
+    }
+    result.setTreeStats(parent, partner, baseStationId);
+
+    if (par("gatheringRounds").intValue() > 0)
+    {
+        std::vector<double> energy(solver.getNumHosts()), energyMTD(solver.getNumHosts());
+        for (int i = 0; i < solver.getNumHosts(); ++i)
+        {
+            energy[i] = solver.getReportEnergy(i);
+            energyMTD[i] = solver.getReportEnergyMTD(i);
+        }
+        runGathering(parent, energy, "gathering");
+        runGathering(parent, energyMTD, "gatheringMTD");
+    }
+
+    if (topologyEpochs > 0)
+        runTopologyEpochs(solver, graph, topologyEpochs);
+    if (par("batteryCapacity").doubleValue() > 0)
+    {
+        runLifetime(NetworkLifetime::VMER, "lifetime");
+        runLifetime(NetworkLifetime::MTD, "lifetimeMTD");
+    }
+}
+
+void PhaseCoordinator::runTopologyEpochs(VmerSolver& solver, NeighborGraph& graph, int numEpochs)
+{
+    int failuresPerEpoch = par("failuresPerEpoch");
+    int movesPerEpoch = par("movesPerEpoch");
+    double moveDistance = par("moveDistance");
+    double maxRange = medium->getMaxRange();
+    int numHosts = hosts.size();
+    std::vector<double> x(numHosts), y(numHosts);
+    std::vector<bool> alive(numHosts, true);
+    std::vector<int> candidates;    // hosts that may still fail or move
+    for (int i = 0; i < numHosts; ++i)
+    {
+        x[i] = medium->getHostX(i);
+        y[i] = medium->getHostY(i);
+        if (i != baseStationId)
+            candidates.push_back(i);
+    }
+
+    cOutVector energyVector("epochTotalEnergy");
+    cOutVector energyMTDVector("epochTotalEnergyMTD");
+    cOutVector reachableVector("epochReachableHosts");
+    SpatialGrid grid;
+    grid.build(x, y, maxRange, &alive);
+    std::vector<int> updated, changed;
+    long reparented = 0, pairingsRedone = 0;
+    int epoch = 0;
+    Clock::time_point start = Clock::now();
+    for (; epoch < numEpochs && !candidates.empty(); ++epoch)
+    {
+        updated.clear();
+        for (int k = 0; k < failuresPerEpoch && !candidates.empty(); ++k)
+        {
+            int c = intuniform(0, candidates.size() - 1);
+            updated.push_back(candidates[c]);
+            alive[candidates[c]] = false;
+            candidates[c] = candidates.back();
+            candidates.pop_back();
+        }
+        for (int k = 0; k < movesPerEpoch && !candidates.empty(); ++k)
+        {
+            int i = candidates[intuniform(0, candidates.size() - 1)];
+            double angle = uniform(0, 2 * M_PI);
+            x[i] += moveDistance * std::cos(angle);
+            y[i] += moveDistance * std::sin(angle);
+            updated.push_back(i);
+        }
+        std::sort(updated.begin(), updated.end());
+        updated.erase(std::unique(updated.begin(), updated.end()), updated.end());
+
+        grid.update(updated, &alive);
+        changed.clear();
+        graph.update(updated, x, y, alive, grid, maxRange, changed);
+        solver.update(updated, changed);
+        reparented += solver.getNumReparented();
+        pairingsRedone += solver.getNumPairingsRedone();
+
+        int reachable = 0;
+        for (int i = 0; i < numHosts; ++i)
+            if (solver.getParentId(i) != -1)
+                reachable++;
+        energyVector.record(solver.getTotalEnergy());
+        energyMTDVector.record(solver.getTotalEnergyMTD());
+        reachableVector.record(reachable);
+    }
+    double wallTime = std::chrono::duration<double>(Clock::now() - start).count();
+    EV << "Applied " << epoch << " topology epochs in " << wallTime << "s" << endl;
+    recordScalar("epochs:count", epoch);
+    recordScalar("epochs:wallTime", wallTime, "s");
+    recordScalar("epochs:reparented", reparented);
+    recordScalar("epochs:pairingsRedone", pairingsRedone);
+}
+
+static bool isClose(double a, double b, double tolerance)
+{
+    return a == b || std::fabs(a - b) <= tolerance * std::max(std::fabs(a), std::fabs(b));
+}
+
+void PhaseCoordinator::crossCheck()
+{
+    if (phase != PRINT_TOTAL_ENERGY || outstanding != 0)
+    {
+        EV_WARN << "Simulation stopped in phase " << getPhaseName(phase) << ", solver cross-check skipped" << endl;
+        return;
+    }
+
+    cModule *network = getParentModule();
+    VmerSolver solver(medium->getNeighborGraph(), medium->getRadioModel(), medium->getMaxRange(), baseStationId, network->par("gamma").doubleValue());
+    runSolver(solver);
+
+    int parentMismatches = 0, partnerMismatches = 0;
+    for (int i = 0; i < (int)hosts.size(); ++i)
+    {
+        if (hosts[i]->getParentId() != solver.getParentId(i))
+            parentMismatches++;
+        if (hosts[i]->getPartnerId() != solver.getPartnerId(i))
+            partnerMismatches++;
+    }
+    Host *baseStation = hosts[baseStationId];
+    recordScalar("crossCheck:parentMismatches", parentMismatches);
+    recordScalar("crossCheck:partnerMismatches", partnerMismatches);
+    recordScalar("crossCheck:solverTotalEnergy", solver.getTotalEnergy());
+    recordScalar("crossCheck:solverTotalEnergyMTD", solver.getTotalEnergyMTD());
+
+    if (parentMismatches != 0 || partnerMismatches != 0
+            || !isClose(baseStation->getTotalEnergy(), solver.getTotalEnergy(), crossCheckTolerance)
+            || !isClose(baseStation->getTotalEnergyMTD(), solver.getTotalEnergyMTD(), crossCheckTolerance))
+        throw cRuntimeError("Solver disagrees with the simulation: %d parents and %d partners differ, "
+                "total energy %g vs %g, MTD total energy %g vs %g", parentMismatches, partnerMismatches,
+                baseStation->getTotalEnergy(), solver.getTotalEnergy(), baseStation->getTotalEnergyMTD(), solver.getTotalEnergyMTD());
+    EV << "Solver agrees with the simulation" << endl;
+}
+
+void PhaseCoordinator::runGathering(const std::vector<int>& parent, const std::vector<double>& energyPerBit, const char *name)
+{
+    DataGathering::Parameters params;
+    params.payloadBits = par("payloadBits").intValue();
+    params.headerBits = par("headerBits").intValue();
+    params.aggregationRatio = par("aggregationRatio");
+    params.reportProbability = par("reportProbability");
+    uint64_t seed = (uint64_t)getRNG(0)->intRand() << 32 | getRNG(0)->intRand();
+    DataGathering gathering(parent, energyPerBit, baseStationId, params, seed);
+
+    Clock::time_point start = Clock::now();
+    gathering.runRounds(par("gatheringRounds").intValue());
+    double wallTime = std::chrono::duration<double>(Clock::now() - start).count();
+    EV << "Ran " << gathering.getNumRounds() << " " << name << " rounds in " << wallTime << "s, "
+       << gathering.getMeanEnergyPerRound() << " J per round" << endl;
+
+    std::string prefix = std::string(name) + ":";
+    double rounds = gathering.getNumRounds();
+    recordScalar((prefix + "rounds").c_str(), rounds);
+    recordScalar((prefix + "energyPerRound").c_str(), gathering.getMeanEnergyPerRound(), "J");
+    recordScalar((prefix + "energyPerRoundStddev").c_str(), gathering.getEnergyPerRoundStddev(), "J");
+    recordScalar((prefix + "energyPerBit").c_str(), gathering.getEnergyPerDeliveredBit(), "J");
+    recordScalar((prefix + "deliveredBitsPerRound").c_str(), gathering.getDeliveredBits() / rounds, "b");
+    recordScalar((prefix + "droppedBitsPerRound").c_str(), gathering.getDroppedBits() / rounds, "b");
+    recordScalar((prefix + "wallTime").c_str(), wallTime, "s");
+}
+
+void PhaseCoordinator::runLifetime(NetworkLifetime::Scheme scheme, const char *name)
+{
+    NetworkLifetime::Parameters params;
+    params.batteryCapacity = par("batteryCapacity");
+    params.gathering.payloadBits = par("payloadBits").intValue();
+    params.gathering.headerBits = par("headerBits").intValue();
+    params.gathering.aggregationRatio = par("aggregationRatio");
+    params.gathering.reportProbability = par("reportProbability");
+    params.maxRounds = par("lifetimeMaxRounds").intValue();
+    std::vector<double> x(hosts.size()), y(hosts.size());
+    for (int i = 0; i < (int)hosts.size(); ++i)
+    {
+        x[i] = medium->getHostX(i);
+        y[i] = medium->getHostY(i);
+    }
+
+    // planned from scratch on the initial placement, which gives the tree
+    // and pairing of the protocol
+    Clock::time_point start = Clock::now();
+    NetworkLifetime lifetime(x, y, medium->getNeighborGraph(), medium->getRadioModel(), medium->getMaxRange(),
+            baseStationId, getParentModule()->par("gamma").doubleValue(), scheme, params);
+    lifetime.setTiming(getSolverTiming());
+    lifetime.setTreeScopedRouteDiscovery(isTreeScopedRouteDiscovery());
+    lifetime.run();
+    double wallTime = std::chrono::duration<double>(Clock::now() - start).count();
+    EV << "Ran " << lifetime.getNumRounds() << " " << name << " rounds in " << wallTime << "s, first death after "
+       << lifetime.getFirstDeathRound() << " rounds, " << lifetime.getNumRebuilds() << " re-plans";
+    if (scheme == NetworkLifetime::VMER)
+        EV << ", " << lifetime.getNumCooperativeHosts() << " cooperative hops, " << lifetime.getNumFallbackHosts()
+           << " hosts on MTD hops";
+    EV << endl;
+
+    std::string prefix = std::string(name) + ":";
+    recordScalar((prefix + "firstDeath").c_str(), lifetime.getFirstDeathRound());
+    recordScalar((prefix + "halfLost").c_str(), lifetime.getHalfLostRound());
+    recordScalar((prefix + "halfDead").c_str(), lifetime.getHalfDeadRound());
+    recordScalar((prefix + "rounds").c_str(), lifetime.getNumRounds());
+    recordScalar((prefix + "deadHosts").c_str(), lifetime.getNumDead());
+    recordScalar((prefix + "rebuilds").c_str(), lifetime.getNumRebuilds());
+    if (scheme == NetworkLifetime::VMER)
+    {
+        recordScalar((prefix + "cooperativeHosts").c_str(), lifetime.getNumCooperativeHosts());
+        recordScalar((prefix + "fallbackHosts").c_str(), lifetime.getNumFallbackHosts());
+    }
+    recordScalar((prefix + "wallTime").c_str(), wallTime, "s");
+}
+
+void PhaseCoordinator::finish()
+{
+    if (mode == CROSSCHECK)
+        crossCheck();
+
+    // simulated runs gather on the tree the hosts built
+    if (mode != SOLVE && par("gatheringRounds").intValue() > 0 && phase == PRINT_TOTAL_ENERGY && outstanding == 0)
+    {
+        std::vector<int> parent(hosts.size());
+        std::vector<double> energy(hosts.size()), energyMTD(hosts.size());
+        for (int i = 0; i < (int)hosts.size(); ++i)
+        {
+            parent[i] = hosts[i]->getParentId();
+            energy[i] = hosts[i]->getReportEnergy();
+            energyMTD[i] = hosts[i]->getReportEnergyMTD();
+        }
+        runGathering(parent, energy, "gathering");
+        runGathering(parent, energyMTD, "gatheringMTD");
+    }
+    if (mode != SOLVE && par("batteryCapacity").doubleValue() > 0 && phase == PRINT_TOTAL_ENERGY && outstanding == 0)
+    {
+        runLifetime(NetworkLifetime::VMER, "lifetime");
+        runLifetime(NetworkLifetime::MTD, "lifetimeMTD");
+    }
+    for (int i = 0; i < NUM_PHASES; ++i)
+    {
+        if (phaseStartTime[i] < 0)
+            continue;
+        bool last = i + 1 == NUM_PHASES || phaseStartTime[i + 1] < 0;
+        simtime_t end = last ? simTime() : phaseStartTime[i + 1];
+        Clock::time_point wallEnd = last ? Clock::now() : phaseWallStart[i + 1];
+        eventnumber_t endEvent = last ? getSimulation()->getEventNumber() : phaseFirstEvent[i + 1];
+        std::string name = phaseNames[i];
+        recordScalar((name + ":start").c_str(), phaseStartTime[i], "s");
+        recordScalar((name + ":duration").c_str(), end - phaseStartTime[i], "s");
+        recordScalar((name + ":wallTime").c_str(), std::chrono::duration<double>(wallEnd - phaseWallStart[i]).count(), "s");
+        recordScalar((name + ":events").c_str(), (double)(endEvent - phaseFirstEvent[i]));
+        const PhaseCounters& c = counters[i];
+        recordScalar((name + ":packets").c_str(), (double)c.packets);
+        recordScalar((name + ":bitsSent").c_str(), (double)c.bitsSent, "b");
+        for (int kind = 0; kind < NUM_PACKET_KINDS; ++kind)
+        {
+            if (c.sent[kind] != 0)
+                recordScalar((name + ":sent:" + packetKindNames[kind]).c_str(), (double)c.sent[kind]);
+            if (c.received[kind] != 0)
+                recordScalar((name + ":received:" + packetKindNames[kind]).c_str(), (double)c.received[kind]);
+        }
+        if (c.relaxations != 0)
+            recordScalar((name + ":relaxations").c_str(), (double)c.relaxations);
+        if (profileHandlers)
+            recordScalar((name + ":handlerTime").c_str(), c.handlerTime, "s");
+    }
+    recordScalar("events", (double)getSimulation()->getEventNumber());
+    if (solverWallTime >= 0)
+        recordScalar("solver:wallTime", solverWallTime, "s");
+    if (par("resultFile").stdstringValue() != "")
+        writeResult();
+}
+
+void PhaseCoordinator::writeResult()
+{
+    cConfigurationEx *config = getEnvir()->getConfigEx();
+    cModule *network = getParentModule();
+    strncpy(result.configName, config->getActiveConfigName(), sizeof(result.configName) - 1);
+    result.runNumber = config->getActiveRunNumber();
+    result.seedSet = atoll(config->getVariable(CFGVAR_SEEDSET));
+    result.mode = mode;
+    result.numHosts = hosts.size();
+    result.square = network->par("square").doubleValue();
+    result.gamma = network->par("gamma").doubleValue();
+
+    // solve() has filled in the rest
+    if (mode != SOLVE)
+    {
+        Host *baseStation = hosts[baseStationId];
+        result.complete = phase == PRINT_TOTAL_ENERGY && outstanding == 0;
+        result.totalEnergy = baseStation->getTotalEnergy();
+        result.totalEnergyMTD = baseStation->getTotalEnergyMTD();
+        for (int i = 0; i < NUM_PHASES; ++i)
+            result.packets[i] = counters[i].packets;
+        std::vector<int> parent(hosts.size()), partner(hosts.size());
+        for (int i = 0; i < (int)hosts.size(); ++i)
+        {
+            parent[i] = hosts[i]->getParentId();
+            partner[i] = hosts[i]->getPartnerId();
+        }
+        result.setTreeStats(parent, partner, baseStationId);
+    }
+
+    ResultSink *sink = ResultSink::forFile(par("resultFile").stdstringValue(), par("resultBatchSize"));
+    if (!sink->append(result))
+        throw cRuntimeError("%s", sink->errorMessage().c_str());
+}
+
+}; //namespace
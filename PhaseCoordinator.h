@@ -0,0 +1,130 @@
+//
+// This file is part of an OMNeT++/OMNEST simulation example.
+//
+// Copyright (C) 1992-2015 Andras Varga
+//
+// This file is distributed WITHOUT ANY WARRANTY. See the file
+// `license' for details on this and other legal matters.
+//
+
+#ifndef __ALOHA_PHASECOORDINATOR_H_
+#define __ALOHA_PHASECOORDINATOR_H_
+
+#include <chrono>
+#include <cstdio>
+#include <omnetpp.h>
+
+#include "ControlPackets_m.h"
+#include "DataGathering.h"
+#include "NeighborGraph.h"
+#include "NetworkLifetime.h"
+#include "RadioMedium.h"
+#include "ResultSink.h"
+#include "SpatialGrid.h"
+#include "VmerSolver.h"
+
+using namespace omnetpp;
+
+namespace aloha {
+
+class Host;
+
+/**
+ * Starts each protocol phase once the previous one has quiesced; see NED
+ * file for more info.
+ */
+class PhaseCoordinator : public cSimpleModule
+{
+  public:
+    enum Phase {
+        LOCATION = 0, BELLMAN_FORD, FAMILY, DETECTION, VMER, ENERGY, ENERGY_MTD, PRINT_TOTAL_ENERGY,
+        NUM_PHASES
+    };
+    enum { NUM_PACKET_KINDS = ENERGY_TO_ROOT_MTD_PACKET + 1 };
+
+    enum Mode { SIMULATE, SOLVE, CROSSCHECK };
+
+  private:
+    // parameters
+    simtime_t phaseGap;
+    Mode mode;
+    double crossCheckTolerance;
+    bool profileHandlers;
+
+    // state
+    std::vector<Host *> hosts;
+    int baseStationId;
+    bool treeRestored;
+    int phase = -1;
+    long outstanding = 0;   // control packets in flight plus pending phase timers
+    cMessage *nextPhaseEvent = nullptr;
+    simtime_t phaseStartTime[NUM_PHASES];
+
+    // cost of each phase in the simulator itself, for the scaling runs
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point phaseWallStart[NUM_PHASES];
+    eventnumber_t phaseFirstEvent[NUM_PHASES];
+    double solverWallTime = -1;
+
+    // what the hosts did in each phase, by control packet kind
+    struct PhaseCounters
+    {
+        long sent[NUM_PACKET_KINDS] = {};
+        long received[NUM_PACKET_KINDS] = {};
+        long packets = 0;
+        int64_t bitsSent = 0;
+        double handlerTime = 0;     // s of CPU time, only with profileHandlers
+        long relaxations = 0;       // Bellman-Ford path improvements
+    };
+    PhaseCounters counters[NUM_PHASES];
+    FILE *trace = nullptr;
+    RadioMedium *medium = nullptr;
+    RunRecord result;       // filled by solve() or finish(), see resultFile
+
+  public:
+    virtual ~PhaseCoordinator();
+
+    /**
+     * Hosts call this when they send a control packet or schedule a phase
+     * timer, and activityFinished() when they have handled it.
+     */
+    void activityStarted() { outstanding++; }
+    void activityFinished();
+
+    /**
+     * Like activityStarted(), for a control packet; also counts and traces it.
+     */
+    void packetSent(int kind, int64_t bits, int sender, int target);
+
+    /**
+     * Hosts call this after handling a message (kind 0 for their phase
+     * timers), before activityFinished(); handlerTime is only measured
+     * with profileHandlers.
+     */
+    void messageHandled(int kind, int host, int sender, double handlerTime);
+    void bellmanFordRelaxed() { if (phase >= 0) counters[phase].relaxations++; }
+    bool isProfilingHandlers() const { return profileHandlers; }
+
+    int getPhase() const { return phase; }
+    simtime_t getPhaseStartTime(int phase) const { return phaseStartTime[phase]; }
+    static const char *getPhaseName(int phase);
+
+  protected:
+    virtual void    initialize() override;
+    virtual void    handleMessage(cMessage *msg) override;
+    virtual void    finish() override;
+    void            startPhase(int phase);
+    VmerSolver::Timing getSolverTiming();
+    bool            isTreeScopedRouteDiscovery();
+    void            runSolver(VmerSolver& solver);
+    void            solve();
+    void            runTopologyEpochs(VmerSolver& solver, NeighborGraph& graph, int numEpochs);
+    void            crossCheck();
+    void            writeResult();
+    void            runGathering(const std::vector<int>& parent, const std::vector<double>& energyPerBit, const char *name);
+    void            runLifetime(NetworkLifetime::Scheme scheme, const char *name);
+};
+
+}; //namespace
+
+#endif
@@ -0,0 +1,112 @@
+//
+// This file is part of an OMNeT++/OMNEST simulation example.
+//
+// Copyright (C) 1992-2015 Andras Varga
+//
+// This file is distributed WITHOUT ANY WARRANTY. See the file
+// `license' for details on this and other legal matters.
+//
+
+#include "RadioMedium.h"
+
+using namespace std;
+
+namespace aloha {
+
+Define_Module(RadioMedium);
+
+std::shared_ptr<Topology> RadioMedium::lastTopology;
+
+void RadioMedium::initialize()
+{
+    cModule *network = getParentModule();
+    RadioParameters params;
+    params.constellation = network->par("constellation").doubleValue();
+    params.bitErrorProbability = network->par("bitErrorProbability").doubleValue();
+    params.rxtxGain = network->par("rxtxGain").doubleValue();
+    params.waveLength = network->par("waveLength").doubleValue();
+    params.linkMargin = network->par("linkMargin").doubleValue();
+    params.rxNoiseFigure = network->par("rxNoiseFigure").doubleValue();
+    params.noiseSpectralDensity = network->par("noiseSpectralDensity").doubleValue();
+    params.txConsumption = network->par("txConsumption").doubleValue();
+    params.rxConsumption = network->par("rxConsumption").doubleValue();
+    params.synConsumption = network->par("synConsumption").doubleValue();
+    params.bandWidth = network->par("bandWidth").doubleValue();
+    radioModel = RadioModel(params);
+
+    int numHosts = network->par("numHosts");
+    topology = std::make_shared<Topology>();
+    topology->maxRange = network->par("maxRange").doubleValue();
+    hosts.resize(numHosts);
+    topology->x.resize(numHosts);
+    topology->y.resize(numHosts);
+    for (int i = 0; i < numHosts; ++i)
+    {
+        hosts[i] = network->getSubmodule("host", i);
+        topology->x[i] = hosts[i]->par("x").doubleValue();
+        topology->y[i] = hosts[i]->par("y").doubleValue();
+    }
+
+    // positions depend only on the seed, so batched runs that differ
+    // only in gamma can take over the previous run's grid and graph
+    topologyReused = par("reuseTopology").boolValue() && lastTopology && lastTopology->hasSamePlacement(*topology);
+    if (topologyReused)
+    {
+        topology = lastTopology;
+    }
+    else
+    {
+        topology->grid.build(topology->x, topology->y, topology->maxRange);
+        topology->graph.build(topology->x, topology->y, topology->grid, topology->maxRange);
+    }
+    lastTopology = par("reuseTopology").boolValue() ? topology : nullptr;
+    // the memo survives reuse unless the radio parameters changed
+    memoizeEnergy = par("memoizeEnergy").boolValue();
+    if (memoizeEnergy && !topology->energyTable.isBoundTo(topology->graph, params))
+        topology->energyTable.reset(topology->graph, radioModel);
+    treeRestored = topologyReused && par("reuseTree").boolValue() && topology->tree.isComplete();
+    if (!topology->tree.isComplete())
+    {
+        topology->tree.parent.assign(numHosts, -1);
+        topology->tree.shortestPathDistance.assign(numHosts, INFINITY);
+        topology->tree.recorded.assign(numHosts, false);
+        topology->tree.numRecorded = 0;
+    }
+    EV << "Neighbor graph" << (topologyReused ? " (reused)" : "") << ": " << numHosts << " hosts, "
+       << topology->graph.getNumEdges() << " directed links, " << topology->graph.getMemoryUsage() << " bytes" << endl;
+}
+
+void RadioMedium::recordTreeState(int hostId, int parentId, double shortestPathDistance)
+{
+    TreeSnapshot& tree = topology->tree;
+    if (tree.isComplete() || tree.recorded[hostId])
+        return;
+    tree.parent[hostId] = parentId;
+    tree.shortestPathDistance[hostId] = shortestPathDistance;
+    tree.recorded[hostId] = true;
+    if (++tree.numRecorded == (int)tree.parent.size())
+        tree.buildChildIndex();
+}
+
+void TreeSnapshot::buildChildIndex()
+{
+    int n = parent.size();
+    childStart.assign(n + 1, 0);
+    for (int i = 0; i < n; ++i)
+        if (parent[i] != -1)
+            childStart[parent[i] + 1]++;
+    for (int i = 0; i < n; ++i)
+        childStart[i + 1] += childStart[i];
+    childIds.resize(childStart[n]);
+    std::vector<int> fill(childStart.begin(), childStart.end() - 1);
+    for (int i = 0; i < n; ++i)
+        if (parent[i] != -1)
+            childIds[fill[parent[i]]++] = i;
+}
+
+void RadioMedium::handleMessage(cMessage *msg)
+{
+    throw cRuntimeError("RadioMedium does not process messages");
+}
+
+}; //namespace
@@ -0,0 +1,118 @@
+//
+// This file is part of an OMNeT++/OMNEST simulation example.
+//
+// Copyright (C) 1992-2015 Andras Varga
+//
+// This file is distributed WITHOUT ANY WARRANTY. See the file
+// `license' for details on this and other legal matters.
+//
+
+#ifndef __ALOHA_RADIOMEDIUM_H_
+#define __ALOHA_RADIOMEDIUM_H_
+
+#include <memory>
+#include <omnetpp.h>
+
+#include "EnergyTable.h"
+#include "RadioModel.h"
+#include "NeighborGraph.h"
+#include "SpatialGrid.h"
+
+using namespace omnetpp;
+
+namespace aloha {
+
+/**
+ * Shortest-path tree built by the location, Bellman-Ford and family
+ * phases, as recorded by the hosts at the end of a run.
+ */
+struct TreeSnapshot
+{
+    std::vector<int> parent;                    // -1 for the base station and unreachable hosts
+    std::vector<double> shortestPathDistance;
+    std::vector<bool> recorded;
+    int numRecorded = 0;
+
+    // children of host i are childIds[childStart[i]..childStart[i+1]), in increasing id order
+    std::vector<int> childStart, childIds;
+
+    bool isComplete() const { return !parent.empty() && numRecorded == (int)parent.size(); }
+    void buildChildIndex();
+};
+
+/**
+ * Host positions and the structures derived from them. Consecutive runs
+ * of one process that place the hosts identically (same seed, different
+ * gamma) share one instance; see RadioMedium's reuseTopology parameter.
+ */
+struct Topology
+{
+    double maxRange = 0;
+    std::vector<double> x, y;   // host positions, unit is m
+    SpatialGrid grid;
+    NeighborGraph graph;
+    TreeSnapshot tree;
+    EnergyTable energyTable;    // link energies memoized over the graph
+
+    bool hasSamePlacement(const Topology& other) const { return maxRange == other.maxRange && x == other.x && y == other.y; }
+};
+
+/**
+ * Shared radio medium of the VirtualMIMO network; see NED file for more info.
+ */
+class RadioMedium : public cSimpleModule
+{
+  private:
+    RadioModel radioModel;
+    bool topologyReused = false;
+    bool treeRestored = false;
+    bool memoizeEnergy = false;
+
+    // host modules and the topology built from their positions
+    std::vector<cModule *> hosts;
+    std::shared_ptr<Topology> topology;
+
+    // topology of the previous run in this process, kept for reuse
+    static std::shared_ptr<Topology> lastTopology;
+
+  public:
+    const RadioModel& getRadioModel() const { return radioModel; }
+
+    int getNumHosts() const { return hosts.size(); }
+    cModule **getHosts() { return hosts.data(); }
+    double getMaxRange() const { return topology->maxRange; }
+    double getHostX(int i) const { return topology->x[i]; }
+    double getHostY(int i) const { return topology->y[i]; }
+    bool isTopologyReused() const { return topologyReused; }
+
+    /**
+     * Tree of a previous run with the same placement, to be restored by the
+     * hosts instead of running the tree-building phases; nullptr if there is
+     * none or the reuseTree parameter is off.
+     */
+    const TreeSnapshot *getTreeSnapshot() const { return treeRestored ? &topology->tree : nullptr; }
+
+    /**
+     * Called by each host at the end of the run to record its place in the tree.
+     */
+    void recordTreeState(int hostId, int parentId, double shortestPathDistance);
+
+    /**
+     * Network-wide memo of link energies per bit, valid for the current
+     * positions and radio parameters; nullptr if memoizeEnergy is off.
+     */
+    EnergyTable *getEnergyTable() { return memoizeEnergy ? &topology->energyTable : nullptr; }
+
+    /**
+     * In-range pairs of hosts with their distances, built once at initialization.
+     */
+    const NeighborGraph& getNeighborGraph() const { return topology->graph; }
+
+  protected:
+    virtual void    initialize() override;
+    virtual void    handleMessage(cMessage *msg) override;
+};
+
+}; //namespace
+
+#endif
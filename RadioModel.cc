@@ -0,0 +1,149 @@
+//
+// This file is part of an OMNeT++/OMNEST simulation example.
+//
+// Copyright (C) 1992-2015 Andras Varga
+//
+// This file is distributed WITHOUT ANY WARRANTY. See the file
+// `license' for details on this and other legal matters.
+//
+
+#include <cmath>
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#include "RadioModel.h"
+
+namespace aloha {
+
+// the mode-independent quantities of the model
+struct ModelQuantities
+{
+    double constSize, pBitError, gain, lambda, spectralDensity, alpha, Ml, NF;
+    double Ptc, Psyn, Prc, BW;
+};
+
+template<int NumTx, int NumRx>
+static void computeMode(const ModelQuantities& q, double& energyFactor, double& systemEnergy)
+{
+    // the same expression as the original per-call formula up to the
+    // scaled distance, with the exponents (integer division included)
+    // taken from EnergyModel
+    typedef EnergyModel<NumTx, NumRx> Mode;
+    systemEnergy = ((NumTx*q.Ptc)+(2*q.Psyn)+(NumRx*q.Prc))/(q.BW*q.constSize);
+    energyFactor = (2.0/3.0)*(1 + q.alpha) * std::pow(q.pBitError / 4 , Mode::bitErrorExponent)*((std::pow(2,q.constSize) - 1)/(std::pow(q.constSize, Mode::constellationExponent)))*q.spectralDensity;
+}
+
+RadioModel::RadioModel(const RadioParameters& params) : params(params)
+{
+    ModelQuantities q;
+    q.constSize = params.constellation;
+    double epsilon = 3*(std::sqrt(std::pow(2,q.constSize))-1)/(std::sqrt(std::pow(2,q.constSize))+1);
+    q.pBitError = params.bitErrorProbability;
+    q.gain = std::pow(10,params.rxtxGain/10);
+    q.lambda = params.waveLength;
+    q.spectralDensity = std::pow(10,(params.noiseSpectralDensity-30)/10);
+    q.alpha = (epsilon / 0.35) - 1;
+    q.Ml = std::pow(10,params.linkMargin/10);
+    q.NF = std::pow(10,params.rxNoiseFigure/10);
+
+    q.Ptc = params.txConsumption / 1000;
+    q.Psyn = params.synConsumption / 1000;
+    q.Prc = params.rxConsumption / 1000;
+    q.BW = params.bandWidth;
+
+    txCircuitEnergy = q.Ptc/(q.BW*q.constSize);
+    rxCircuitEnergy = q.Prc/(q.BW*q.constSize);
+    synthesizerEnergy = q.Psyn/(q.BW*q.constSize);
+    linkMargin = q.Ml;
+    noiseFigure = q.NF;
+    pathGain = q.gain*std::pow(q.lambda,2);
+    computeMode<1, 1>(q, modes[0][0].energyFactor, modes[0][0].systemEnergy);
+    computeMode<1, 2>(q, modes[0][1].energyFactor, modes[0][1].systemEnergy);
+    computeMode<2, 1>(q, modes[1][0].energyFactor, modes[1][0].systemEnergy);
+    computeMode<2, 2>(q, modes[1][1].energyFactor, modes[1][1].systemEnergy);
+}
+
+//
+// The kernels below compute a*x + b as a separate multiply and add, never
+// fused, which is what the scalar expressions compile to with
+// -ffp-contract=off; makefrag and benchmarks/Makefile set it, as clang
+// (and GCC in GNU mode) would otherwise contract them into FMAs. Lanes are
+// independent, and division is correctly rounded in every SIMD set as in
+// scalar code, so the vector and scalar paths give the same bits
+// (vmerbench checks this on every run).
+//
+static void multiplyAdd(const double *x, double a, double b, double *y, int n)
+{
+    int i = 0;
+#if defined(__AVX__)
+    __m256d va = _mm256_set1_pd(a), vb = _mm256_set1_pd(b);
+    for (; i + 4 <= n; i += 4)
+        _mm256_storeu_pd(y + i, _mm256_add_pd(_mm256_mul_pd(va, _mm256_loadu_pd(x + i)), vb));
+#elif defined(__SSE2__)
+    __m128d va = _mm_set1_pd(a), vb = _mm_set1_pd(b);
+    for (; i + 2 <= n; i += 2)
+        _mm_storeu_pd(y + i, _mm_add_pd(_mm_mul_pd(va, _mm_loadu_pd(x + i)), vb));
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    float64x2_t va = vdupq_n_f64(a), vb = vdupq_n_f64(b);
+    for (; i + 2 <= n; i += 2)
+        vst1q_f64(y + i, vaddq_f64(vmulq_f64(va, vld1q_f64(x + i)), vb));
+#endif
+    for (; i < n; ++i)
+        y[i] = a * x[i] + b;
+}
+
+// y[i] = (x[i] * a * b) / c, left to right
+static void multiplyDivide(const double *x, double a, double b, double c, double *y, int n)
+{
+    int i = 0;
+#if defined(__AVX__)
+    __m256d va = _mm256_set1_pd(a), vb = _mm256_set1_pd(b), vc = _mm256_set1_pd(c);
+    for (; i + 4 <= n; i += 4)
+        _mm256_storeu_pd(y + i, _mm256_div_pd(_mm256_mul_pd(_mm256_mul_pd(_mm256_loadu_pd(x + i), va), vb), vc));
+#elif defined(__SSE2__)
+    __m128d va = _mm_set1_pd(a), vb = _mm_set1_pd(b), vc = _mm_set1_pd(c);
+    for (; i + 2 <= n; i += 2)
+        _mm_storeu_pd(y + i, _mm_div_pd(_mm_mul_pd(_mm_mul_pd(_mm_loadu_pd(x + i), va), vb), vc));
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    float64x2_t va = vdupq_n_f64(a), vb = vdupq_n_f64(b), vc = vdupq_n_f64(c);
+    for (; i + 2 <= n; i += 2)
+        vst1q_f64(y + i, vdivq_f64(vmulq_f64(vmulq_f64(vld1q_f64(x + i), va), vb), vc));
+#endif
+    for (; i < n; ++i)
+        y[i] = (x[i] * a * b) / c;
+}
+
+void RadioModel::energyPerBit(int numTx, int numRx, const double *squaredDistanceSums, double *energies, int n) const
+{
+    const ModeConstants& m = modes[numTx - 1][numRx - 1];
+    multiplyDivide(squaredDistanceSums, linkMargin, noiseFigure, pathGain, energies, n);
+    multiplyAdd(energies, m.energyFactor, m.systemEnergy, energies, n);
+}
+
+void RadioModel::pairingWeights(const double *childSquaredDistances, int n, double childShare,
+        double parentEnergy, double cooperativeEnergy, double *weights) const
+{
+    energyPerBit(1, 1, childSquaredDistances, weights, n);
+    multiplyAdd(weights, childShare, parentEnergy, weights, n);
+    int i = 0;
+#if defined(__AVX__)
+    __m256d vc = _mm256_set1_pd(cooperativeEnergy);
+    for (; i + 4 <= n; i += 4)
+        _mm256_storeu_pd(weights + i, _mm256_sub_pd(_mm256_loadu_pd(weights + i), vc));
+#elif defined(__SSE2__)
+    __m128d vc = _mm_set1_pd(cooperativeEnergy);
+    for (; i + 2 <= n; i += 2)
+        _mm_storeu_pd(weights + i, _mm_sub_pd(_mm_loadu_pd(weights + i), vc));
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    float64x2_t vc = vdupq_n_f64(cooperativeEnergy);
+    for (; i + 2 <= n; i += 2)
+        vst1q_f64(weights + i, vsubq_f64(vld1q_f64(weights + i), vc));
+#endif
+    for (; i < n; ++i)
+        weights[i] -= cooperativeEnergy;
+}
+
+}; //namespace
@@ -0,0 +1,274 @@
+//
+// This file is part of an OMNeT++/OMNEST simulation example.
+//
+// Copyright (C) 1992-2015 Andras Varga
+//
+// This file is distributed WITHOUT ANY WARRANTY. See the file
+// `license' for details on this and other legal matters.
+//
+
+#ifndef __ALOHA_RADIOMODEL_H_
+#define __ALOHA_RADIOMODEL_H_
+
+namespace aloha {
+
+/**
+ * Physical-layer parameters of Table 1, in the units declared in
+ * VirtualMIMO.ned (dB, dBm/Hz, mW, Hz, bit, m).
+ */
+struct RadioParameters
+{
+    double constellation = 8;
+    double bitErrorProbability = 0.001;
+    double rxtxGain = 5;
+    double waveLength = 0.12;
+    double linkMargin = 40;
+    double rxNoiseFigure = 10;
+    double noiseSpectralDensity = -171;
+    double txConsumption = 47.8;
+    double rxConsumption = 69.8;
+    double synConsumption = 50;
+    double bandWidth = 10000;
+
+    bool operator==(const RadioParameters& o) const
+    {
+        return constellation == o.constellation && bitErrorProbability == o.bitErrorProbability && rxtxGain == o.rxtxGain
+                && waveLength == o.waveLength && linkMargin == o.linkMargin && rxNoiseFigure == o.rxNoiseFigure
+                && noiseSpectralDensity == o.noiseSpectralDensity && txConsumption == o.txConsumption
+                && rxConsumption == o.rxConsumption && synConsumption == o.synConsumption && bandWidth == o.bandWidth;
+    }
+};
+
+/**
+ * Energy-per-bit model of the virtual MIMO links. Everything that does
+ * not depend on the link geometry is derived once per (numTx, numRx)
+ * mode. Evaluating a link then takes the sum of the squared
+ * transmitter-receiver distances d2 through the operations of the
+ * original per-call formula, in its order:
+ *
+ *   energyFactor * ((d2 * Ml * NF) / (gain * lambda^2)) + systemEnergy
+ *
+ * Folding Ml*NF/(gain*lambda^2) into energyFactor would save three
+ * operations but is up to 3 ulp off, enough to flip the pairing-weight
+ * comparisons on near ties.
+ *
+ * This class has no OMNeT++ dependency on purpose; see RadioMedium for
+ * the module that builds it from the network parameters.
+ */
+class RadioModel
+{
+  public:
+    RadioModel() : RadioModel(RadioParameters()) {}
+    explicit RadioModel(const RadioParameters& params);
+
+    const RadioParameters& getParameters() const { return params; }
+
+    /**
+     * Energy per bit of a numTx x numRx link (1 or 2 antennas each side),
+     * given the sum of squared distances over all tx-rx antenna pairs.
+     */
+    double energyPerBit(int numTx, int numRx, double squaredDistanceSum) const
+    {
+        const ModeConstants& m = modes[numTx - 1][numRx - 1];
+        return m.energyFactor * scaledDistance(squaredDistanceSum) + m.systemEnergy;
+    }
+
+    /**
+     * The same for a mode fixed at compile time; see EnergyModel.
+     */
+    template<int NumTx, int NumRx>
+    double energyPerBit(double squaredDistanceSum) const
+    {
+        const ModeConstants& m = modes[NumTx - 1][NumRx - 1];
+        return m.energyFactor * scaledDistance(squaredDistanceSum) + m.systemEnergy;
+    }
+
+    /**
+     * energyPerBit() over n links at once, energies[i] for
+     * squaredDistanceSums[i]. Vectorized where the target has SIMD
+     * (SSE2/AVX or NEON), with the same operations as the scalar form,
+     * so results are bit-identical.
+     */
+    void energyPerBit(int numTx, int numRx, const double *squaredDistanceSums, double *energies, int n) const;
+
+    /**
+     * Pairing weights W(u,w) of eq. 7 for the n children w of a host u,
+     * given the squared distances u-w:
+     *
+     *   weights[i] = childShare * E_SISO(u,w_i) + parentEnergy - cooperativeEnergy
+     *
+     * evaluated left to right like the scalar expression in recvDCT.
+     * parentEnergy and cooperativeEnergy are the same for every child.
+     */
+    void pairingWeights(const double *childSquaredDistances, int n, double childShare,
+            double parentEnergy, double cooperativeEnergy, double *weights) const;
+
+    double getEnergyFactor(int numTx, int numRx) const { return modes[numTx - 1][numRx - 1].energyFactor; }
+    double getSystemEnergy(int numTx, int numRx) const { return modes[numTx - 1][numRx - 1].systemEnergy; }
+
+    /**
+     * The share of one antenna in energyPerBit() of a numTx x numRx link,
+     * for charging batteries. Each side has one synthesizer, split between
+     * its antennas; a transmitter also pays the power amplifier for the
+     * squared distances from itself to the receivers. The shares of all
+     * antennas add up to energyPerBit() (up to rounding).
+     */
+    double getTransmitEnergy(int numTx, int numRx, double ownSquaredDistanceSum) const
+    {
+        const ModeConstants& m = modes[numTx - 1][numRx - 1];
+        return txCircuitEnergy + synthesizerEnergy / numTx + m.energyFactor * scaledDistance(ownSquaredDistanceSum);
+    }
+    double getReceiveEnergy(int numRx) const { return rxCircuitEnergy + synthesizerEnergy / numRx; }
+
+  private:
+    struct ModeConstants
+    {
+        double energyFactor = 0;    // J/bit per unit of scaledDistance()
+        double systemEnergy = 0;    // circuit energy in J/bit
+    };
+
+    RadioParameters params;
+    ModeConstants modes[2][2];  // indexed by [numTx-1][numRx-1]
+    double linkMargin = 1;      // Ml, linear
+    double noiseFigure = 1;     // NF, linear
+    double pathGain = 1;        // gain * lambda^2, in m^2
+    double txCircuitEnergy = 0;     // J/bit of one transmit chain
+    double rxCircuitEnergy = 0;     // J/bit of one receive chain
+    double synthesizerEnergy = 0;   // J/bit of one synthesizer
+
+    double scaledDistance(double squaredDistanceSum) const { return (squaredDistanceSum * linkMargin * noiseFigure) / pathGain; }
+};
+
+/**
+ * A (NumTx, NumRx) mode of the energy model, fixed at compile time, so
+ * that a kernel instantiated for it neither branches on the mode nor looks
+ * up its factors at run time. The exponents of the original formula are
+ * constants here, with its integer division: -(1/(numTx*numRx)) is -1 for
+ * SISO and 0 otherwise, 1/(numTx*numRx+1) is always 0.
+ *
+ * squaredDistanceSum() adds the squared distances of the link in the order
+ * of Host::calculateEnergyConsumptionPerBit(), for the transmitter u, its
+ * partner w, the receiver v and the second receiver t:
+ *
+ *   SISO  u -> v            SIMO  u -> {v, t}
+ *   MISO  {u, v} -> t       MIMO  {u, w} -> {v, t}
+ *
+ * d2(a, b) returns the squared distance of two hosts (INFINITY if either
+ * is -1). Only the hosts of the mode are looked at.
+ */
+template<int NumTx, int NumRx>
+struct EnergyModel
+{
+    static_assert(NumTx >= 1 && NumTx <= 2 && NumRx >= 1 && NumRx <= 2, "one or two antennas per side");
+
+    static constexpr int bitErrorExponent = -(1 / (NumTx * NumRx));
+    static constexpr int constellationExponent = 1 / (NumTx * NumRx + 1);
+
+    template<typename SquaredDistance>
+    static double squaredDistanceSum(const SquaredDistance& d2, int u, int w, int v, int t);
+
+    template<typename SquaredDistance>
+    static double energyPerBit(const RadioModel& model, const SquaredDistance& d2, int u, int w, int v, int t)
+    {
+        return model.energyPerBit<NumTx, NumRx>(squaredDistanceSum(d2, u, w, v, t));
+    }
+
+    /**
+     * Calls charge(host, energy) for every antenna of the link with its
+     * share of energyPerBit(), see RadioModel::getTransmitEnergy().
+     */
+    template<typename SquaredDistance, typename Charge>
+    static void chargeAntennas(const RadioModel& model, const SquaredDistance& d2, int u, int w, int v, int t, Charge charge);
+};
+
+template<> template<typename SquaredDistance>
+inline double EnergyModel<1, 1>::squaredDistanceSum(const SquaredDistance& d2, int u, int w, int v, int t)
+{
+    return d2(u, v);
+}
+
+template<> template<typename SquaredDistance>
+inline double EnergyModel<1, 2>::squaredDistanceSum(const SquaredDistance& d2, int u, int w, int v, int t)
+{
+    return d2(u, v) + d2(u, t);
+}
+
+template<> template<typename SquaredDistance>
+inline double EnergyModel<2, 1>::squaredDistanceSum(const SquaredDistance& d2, int u, int w, int v, int t)
+{
+    return d2(u, t) + d2(v, t);
+}
+
+template<> template<typename SquaredDistance>
+inline double EnergyModel<2, 2>::squaredDistanceSum(const SquaredDistance& d2, int u, int w, int v, int t)
+{
+    return d2(u, v) + d2(u, t) + d2(w, v) + d2(w, t);
+}
+
+template<> template<typename SquaredDistance, typename Charge>
+inline void EnergyModel<1, 1>::chargeAntennas(const RadioModel& model, const SquaredDistance& d2, int u, int w, int v, int t, Charge charge)
+{
+    charge(u, model.getTransmitEnergy(1, 1, d2(u, v)));
+    charge(v, model.getReceiveEnergy(1));
+}
+
+template<> template<typename SquaredDistance, typename Charge>
+inline void EnergyModel<1, 2>::chargeAntennas(const RadioModel& model, const SquaredDistance& d2, int u, int w, int v, int t, Charge charge)
+{
+    charge(u, model.getTransmitEnergy(1, 2, d2(u, v) + d2(u, t)));
+    charge(v, model.getReceiveEnergy(2));
+    charge(t, model.getReceiveEnergy(2));
+}
+
+template<> template<typename SquaredDistance, typename Charge>
+inline void EnergyModel<2, 1>::chargeAntennas(const RadioModel& model, const SquaredDistance& d2, int u, int w, int v, int t, Charge charge)
+{
+    charge(u, model.getTransmitEnergy(2, 1, d2(u, t)));
+    charge(v, model.getTransmitEnergy(2, 1, d2(v, t)));
+    charge(t, model.getReceiveEnergy(1));
+}
+
+template<> template<typename SquaredDistance, typename Charge>
+inline void EnergyModel<2, 2>::chargeAntennas(const RadioModel& model, const SquaredDistance& d2, int u, int w, int v, int t, Charge charge)
+{
+    charge(u, model.getTransmitEnergy(2, 2, d2(u, v) + d2(u, t)));
+    charge(w, model.getTransmitEnergy(2, 2, d2(w, v) + d2(w, t)));
+    charge(v, model.getReceiveEnergy(2));
+    charge(t, model.getReceiveEnergy(2));
+}
+
+/**
+ * EnergyModel<numTx, numRx>::energyPerBit() for a mode known only at run
+ * time.
+ */
+template<typename SquaredDistance>
+double energyPerBitOfMode(const RadioModel& model, int numTx, int numRx, const SquaredDistance& d2, int u, int w, int v, int t)
+{
+    switch ((numTx - 1) << 1 | (numRx - 1))
+    {
+        case 0: return EnergyModel<1, 1>::energyPerBit(model, d2, u, w, v, t);
+        case 1: return EnergyModel<1, 2>::energyPerBit(model, d2, u, w, v, t);
+        case 2: return EnergyModel<2, 1>::energyPerBit(model, d2, u, w, v, t);
+        default: return EnergyModel<2, 2>::energyPerBit(model, d2, u, w, v, t);
+    }
+}
+
+/**
+ * EnergyModel<numTx, numRx>::chargeAntennas() for a mode known only at
+ * run time.
+ */
+template<typename SquaredDistance, typename Charge>
+void chargeAntennasOfMode(const RadioModel& model, int numTx, int numRx, const SquaredDistance& d2, int u, int w, int v, int t, Charge charge)
+{
+    switch ((numTx - 1) << 1 | (numRx - 1))
+    {
+        case 0: EnergyModel<1, 1>::chargeAntennas(model, d2, u, w, v, t, charge); break;
+        case 1: EnergyModel<1, 2>::chargeAntennas(model, d2, u, w, v, t, charge); break;
+        case 2: EnergyModel<2, 1>::chargeAntennas(model, d2, u, w, v, t, charge); break;
+        default: EnergyModel<2, 2>::chargeAntennas(model, d2, u, w, v, t, charge); break;
+    }
+}
+
+}; //namespace
+
+#endif
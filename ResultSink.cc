@@ -0,0 +1,163 @@
+//
+// This file is part of an OMNeT++/OMNEST simulation example.
+//
+// Copyright (C) 1992-2015 Andras Varga
+//
+// This file is distributed WITHOUT ANY WARRANTY. See the file
+// `license' for details on this and other legal matters.
+//
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ResultSink.h"
+
+using namespace std;
+
+namespace aloha {
+
+static_assert(sizeof(RunRecord) == 32 + 8 * (15 + RunRecord::NUM_PHASES), "RunRecord must not have padding");
+
+void RunRecord::setTreeStats(const std::vector<int>& parent, const std::vector<int>& partner, int baseStationId)
+{
+    // depth in hops, found by walking up to a host whose depth is known;
+    // chains that end without reaching the base station (or loop) are detached
+    enum { UNKNOWN = -1, DETACHED = -2, ON_PATH = -3 };
+    int n = parent.size();
+    std::vector<int> depth(n, UNKNOWN);
+    std::vector<int> path;
+    if (baseStationId >= 0 && baseStationId < n)
+        depth[baseStationId] = 0;
+    for (int i = 0; i < n; ++i)
+    {
+        int j = i;
+        path.clear();
+        while (j != -1 && depth[j] == UNKNOWN)
+        {
+            depth[j] = ON_PATH;
+            path.push_back(j);
+            j = parent[j];
+        }
+        int d = j == -1 || depth[j] < 0 ? DETACHED : depth[j];
+        for (auto it = path.rbegin(); it != path.rend(); ++it)
+            depth[*it] = d == DETACHED ? DETACHED : ++d;
+    }
+
+    std::vector<bool> hasChildren(n, false);
+    for (int i = 0; i < n; ++i)
+        if (depth[i] > 0)
+            hasChildren[parent[i]] = true;
+    reachableHosts = maxDepth = leafHosts = pairedHosts = 0;
+    double depthSum = 0;
+    for (int i = 0; i < n; ++i)
+    {
+        if (partner[i] != -1)
+            pairedHosts++;
+        if (depth[i] <= 0)
+            continue;
+        reachableHosts++;
+        depthSum += depth[i];
+        maxDepth = std::max<int64_t>(maxDepth, depth[i]);
+        if (!hasChildren[i])
+            leafHosts++;
+    }
+    meanDepth = reachableHosts > 0 ? depthSum / reachableHosts : 0;
+}
+
+// one sink per file name, flushed when the process exits
+static std::map<std::string, std::unique_ptr<ResultSink>> sinks;
+
+ResultSink *ResultSink::forFile(const std::string& fileName, int batchSize)
+{
+    std::unique_ptr<ResultSink>& sink = sinks[fileName];
+    if (!sink)
+        sink.reset(new ResultSink(fileName));
+    sink->batchSize = std::max<size_t>(sink->batchSize, batchSize);
+    return sink.get();
+}
+
+ResultSink::~ResultSink()
+{
+    if (!flush())
+        fprintf(stderr, "<!> Records lost: %s\n", error.c_str());
+}
+
+bool ResultSink::append(const RunRecord& record)
+{
+    pending.push_back(record);
+    return pending.size() < batchSize || flush();
+}
+
+struct ResultFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+};
+
+static bool writeFully(int fd, const void *data, size_t size)
+{
+    const char *p = (const char *)data;
+    while (size > 0)
+    {
+        ssize_t n = write(fd, p, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+bool ResultSink::flush()
+{
+    if (pending.empty())
+        return true;
+    int fd = open(fileName.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (fd < 0)
+    {
+        error = "cannot open result file \"" + fileName + "\": " + strerror(errno);
+        return false;
+    }
+
+    // the lock also covers the header, so that only one process writes it
+    ResultFileHeader expected;
+    memcpy(expected.magic, "VMIMORES", 8);
+    expected.version = RESULT_VERSION;
+    expected.recordSize = sizeof(RunRecord);
+    struct stat st;
+    bool ok = flock(fd, LOCK_EX) == 0 && fstat(fd, &st) == 0;
+    if (ok && st.st_size == 0)
+    {
+        ok = writeFully(fd, &expected, sizeof(expected));
+    }
+    else if (ok)
+    {
+        ResultFileHeader header;
+        if (pread(fd, &header, sizeof(header), 0) != sizeof(header) || memcmp(&header, &expected, sizeof(header)) != 0)
+        {
+            close(fd);
+            error = "\"" + fileName + "\" is not a result file of this version";
+            return false;
+        }
+    }
+    ok = ok && writeFully(fd, pending.data(), pending.size() * sizeof(RunRecord));
+    if (!ok)
+        error = "cannot write result file \"" + fileName + "\": " + strerror(errno);
+    close(fd);  // releases the lock
+    if (ok)
+        pending.clear();
+    return ok;
+}
+
+}; //namespace
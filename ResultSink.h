@@ -0,0 +1,104 @@
+//
+// This file is part of an OMNeT++/OMNEST simulation example.
+//
+// Copyright (C) 1992-2015 Andras Varga
+//
+// This file is distributed WITHOUT ANY WARRANTY. See the file
+// `license' for details on this and other legal matters.
+//
+
+#ifndef __ALOHA_RESULTSINK_H_
+#define __ALOHA_RESULTSINK_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace aloha {
+
+/**
+ * Result of one run, as stored in a result file. Every field is 8 bytes
+ * wide (the name is 32), so the layout has no padding; the readresults
+ * script decodes it with the same field order. Change RESULT_VERSION when
+ * the layout changes.
+ */
+struct RunRecord
+{
+    enum { NUM_PHASES = 8 };    // PhaseCoordinator::NUM_PHASES
+
+    char configName[32] = {};   // truncated, zero padded
+    int64_t runNumber = 0;
+    int64_t seedSet = 0;
+    int64_t mode = 0;           // PhaseCoordinator::Mode
+    int64_t complete = 0;       // 1 if the run reached the final phase
+    int64_t numHosts = 0;
+    double square = 0;          // m
+    double gamma = 0;
+    double totalEnergy = 0;     // vMER, as emitted in mimo_calc
+    double totalEnergyMTD = 0;  // as emitted in mtd_calc
+    int64_t packets[NUM_PHASES] = {};   // control packets sent per phase (simulated runs)
+    int64_t packetsReplayed = 0;        // packets replayed by the solver (solve mode)
+    int64_t reachableHosts = 0; // hosts other than the base station with a parent
+    int64_t maxDepth = 0;       // hops from the farthest host to the base station
+    double meanDepth = 0;       // over the reachable hosts
+    int64_t leafHosts = 0;      // reachable hosts without children
+    int64_t pairedHosts = 0;    // hosts with a partner
+
+    /**
+     * Fills in the tree and pairing statistics from the parent and partner
+     * of every host (-1 for none).
+     */
+    void setTreeStats(const std::vector<int>& parent, const std::vector<int>& partner, int baseStationId);
+};
+
+/**
+ * Appends RunRecords to a binary result file shared by any number of
+ * processes. The file starts with a 16-byte header (the magic "VMIMORES",
+ * the version and the record size, both 32-bit) followed by the records.
+ *
+ * Records are buffered and written batchSize at a time, and when the
+ * process exits. Each batch goes out under an exclusive flock() on the
+ * file, in one append, so concurrent runs (see runbatch) never interleave
+ * their records; a file with another layout is rejected instead of being
+ * appended to.
+ */
+class ResultSink
+{
+  public:
+    enum { RESULT_VERSION = 1 };
+
+    /**
+     * The process-wide sink of the given file; all runs of the process
+     * that name the same file share it, so their records are batched
+     * together. A later call may only raise the batch size.
+     */
+    static ResultSink *forFile(const std::string& fileName, int batchSize);
+
+    ~ResultSink();
+
+    /**
+     * Buffers the record and writes the batch once it is full. Returns
+     * false on a write error; errorMessage() says why.
+     */
+    bool append(const RunRecord& record);
+
+    /**
+     * Writes the buffered records, if any.
+     */
+    bool flush();
+
+    const std::string& getFileName() const { return fileName; }
+    const std::string& errorMessage() const { return error; }
+
+  private:
+    ResultSink(const std::string& fileName) : fileName(fileName) {}
+
+    std::string fileName;
+    size_t batchSize = 1;
+    std::vector<RunRecord> pending;
+    std::string error;
+};
+
+}; //namespace
+
+#endif
@@ -0,0 +1,100 @@
+//
+// This file is part of an OMNeT++/OMNEST simulation example.
+//
+// Copyright (C) 1992-2015 Andras Varga
+//
+// This file is distributed WITHOUT ANY WARRANTY. See the file
+// `license' for details on this and other legal matters.
+//
+
+#include <algorithm>
+#include <cmath>
+
+#include "SpatialGrid.h"
+
+namespace aloha {
+
+void SpatialGrid::build(const std::vector<double>& x, const std::vector<double>& y, double cellSize, const std::vector<bool> *alive)
+{
+    xs = &x;
+    ys = &y;
+    this->cellSize = cellSize;
+    int n = x.size();
+    pointCell.assign(n, -1);
+    if (n == 0)
+    {
+        numCellsX = numCellsY = 0;
+        cellItems.clear();
+        return;
+    }
+
+    minX = *std::min_element(x.begin(), x.end());
+    minY = *std::min_element(y.begin(), y.end());
+    double maxX = *std::max_element(x.begin(), x.end());
+    double maxY = *std::max_element(y.begin(), y.end());
+    numCellsX = std::max(1, (int)std::floor((maxX - minX) / cellSize) + 1);
+    numCellsY = std::max(1, (int)std::floor((maxY - minY) / cellSize) + 1);
+
+    cellItems.resize(getNumCells());
+    for (std::vector<int>& items : cellItems)
+        items.clear();
+    for (int i = 0; i < n; ++i)
+    {
+        if (alive && !(*alive)[i])
+            continue;
+        pointCell[i] = cellOf(x[i], y[i]);
+        cellItems[pointCell[i]].push_back(i);
+    }
+}
+
+void SpatialGrid::update(const std::vector<int>& points, const std::vector<bool> *alive)
+{
+    for (int i : points)
+    {
+        int c = (alive && !(*alive)[i]) ? -1 : cellOf((*xs)[i], (*ys)[i]);
+        if (c == pointCell[i])
+            continue;
+        if (pointCell[i] != -1)
+        {
+            std::vector<int>& items = cellItems[pointCell[i]];
+            *std::find(items.begin(), items.end(), i) = items.back();
+            items.pop_back();
+        }
+        if (c != -1)
+            cellItems[c].push_back(i);
+        pointCell[i] = c;
+    }
+}
+
+int SpatialGrid::cellOf(double px, double py) const
+{
+    int cx = std::max(0, std::min(numCellsX - 1, (int)std::floor((px - minX) / cellSize)));
+    int cy = std::max(0, std::min(numCellsY - 1, (int)std::floor((py - minY) / cellSize)));
+    return cy * numCellsX + cx;
+}
+
+void SpatialGrid::queryNeighbors(int i, double range, std::vector<int>& result) const
+{
+    double px = (*xs)[i], py = (*ys)[i];
+    int reach = std::max(1, (int)std::ceil(range / cellSize));
+    int c = cellOf(px, py);
+    int cx = c % numCellsX, cy = c / numCellsX;
+    size_t first = result.size();
+    for (int gy = std::max(0, cy - reach); gy <= std::min(numCellsY - 1, cy + reach); ++gy)
+    {
+        for (int gx = std::max(0, cx - reach); gx <= std::min(numCellsX - 1, cx + reach); ++gx)
+        {
+            for (int j : cellItems[gy * numCellsX + gx])
+            {
+                if (j == i)
+                    continue;
+                double dx = px - (*xs)[j], dy = py - (*ys)[j];
+                if (std::sqrt(dx * dx + dy * dy) <= range)
+                    result.push_back(j);
+            }
+        }
+    }
+    std::sort(result.begin() + first, result.end());
+}
+
+}; //namespace
@@ -0,0 +1,65 @@
+//
+// This file is part of an OMNeT++/OMNEST simulation example.
+//
+// Copyright (C) 1992-2015 Andras Varga
+//
+// This file is distributed WITHOUT ANY WARRANTY. See the file
+// `license' for details on this and other legal matters.
+//
+
+#ifndef __ALOHA_SPATIALGRID_H_
+#define __ALOHA_SPATIALGRID_H_
+
+#include <vector>
+
+namespace aloha {
+
+/**
+ * Uniform grid over the host positions. With the cell size set to the
+ * communication range, all hosts within range of a point lie in the 3x3
+ * block of cells around it, so a range query costs O(k) for k nearby hosts.
+ * Points that move out of the area the grid was built over are kept in
+ * its border cells, which keeps the queries exact.
+ */
+class SpatialGrid
+{
+  public:
+    SpatialGrid() {}
+
+    /**
+     * Buckets the points (x[i], y[i]) into square cells of the given size.
+     * If alive is given, points i with !(*alive)[i] are left out, so they
+     * are nobody's neighbors.
+     */
+    void build(const std::vector<double>& x, const std::vector<double>& y, double cellSize, const std::vector<bool> *alive = nullptr);
+
+    /**
+     * Moves the given points to the cells of their current positions in
+     * the vectors passed to build(), and takes those with !(*alive)[i] out
+     * of the grid; the other cells are not touched.
+     */
+    void update(const std::vector<int>& points, const std::vector<bool> *alive = nullptr);
+
+    /**
+     * Appends the index of every point within range of point i (excluding i)
+     * to result, in increasing index order.
+     */
+    void queryNeighbors(int i, double range, std::vector<int>& result) const;
+
+    int getNumCells() const { return numCellsX * numCellsY; }
+
+  private:
+    int cellOf(double px, double py) const;
+
+    const std::vector<double> *xs = nullptr;
+    const std::vector<double> *ys = nullptr;
+    double cellSize = 0;
+    double minX = 0, minY = 0;
+    int numCellsX = 0, numCellsY = 0;
+    std::vector<std::vector<int>> cellItems;  // point indices of each cell, in no particular order
+    std::vector<int> pointCell;   // cell of each point, -1 if it is left out
+};
+
+}; //namespace
+
+#endif
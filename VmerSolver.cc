@@ -0,0 +1,975 @@
+//
+// This file is part of an OMNeT++/OMNEST simulation example.
+//
+// Copyright (C) 1992-2015 Andras Varga
+//
+// This file is distributed WITHOUT ANY WARRANTY. See the file
+// `license' for details on this and other legal matters.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <queue>
+#include <utility>
+
+#include "VmerSolver.h"
+
+using namespace std;
+
+namespace aloha {
+
+static const int64_t NEVER = INT64_MAX;    // rtdTime of a host that did not terminate
+
+VmerSolver::VmerSolver(const NeighborGraph& graph, const RadioModel& radioModel, double maxRange, int baseStationId, double gamma) :
+    graph(graph), radioModel(radioModel), maxRange(maxRange), baseStationId(baseStationId), gamma(gamma), numHosts(graph.getNumNodes())
+{
+    parent.assign(numHosts, -1);
+    partner.assign(numHosts, -1);
+    parentsPartner.assign(numHosts, -1);
+    shortestPathDistance.assign(numHosts, INFINITY);
+    tp1.assign(numHosts, INFINITY);
+    tp2.assign(numHosts, INFINITY);
+    pnum.assign(numHosts, 2);
+    rtdTerminated.assign(numHosts, false);
+    route1.assign(numHosts, NO_ROUTE);
+    route2.assign(numHosts, NO_ROUTE);
+    rtdInputs.resize(numHosts);
+    rtdTime.assign(numHosts, NEVER);
+    rtdActive.assign(numHosts, false);
+    pairingInput.assign(numHosts, PairingInput());
+    pairingDirty.assign(numHosts, false);
+    pairingDirtyBelow.assign(numHosts, false);
+}
+
+void VmerSolver::setTree(const std::vector<int>& parent, const std::vector<double>& shortestPathDistance)
+{
+    this->parent = parent;
+    this->shortestPathDistance = shortestPathDistance;
+    buildChildIndex();
+    hasTree = true;
+}
+
+void VmerSolver::solve()
+{
+    if (!hasTree)
+        buildTree();
+    selectPartners();
+    discoverRoutes();
+    convergecast();
+}
+
+void VmerSolver::buildTree()
+{
+    // Bellman-Ford over squared distances settles on the same distances and
+    // predecessors as Dijkstra; the cost of a link is added exactly as in
+    // Host::handleBellmanFordMessage, so the sums are bit-identical
+    std::vector<int> via(numHosts, -1);
+    shortestPathDistance.assign(numHosts, INFINITY);
+    typedef std::pair<double, int> Entry;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> open;
+    if (baseStationId >= 0 && baseStationId < numHosts)
+    {
+        shortestPathDistance[baseStationId] = 0;
+        via[baseStationId] = baseStationId;
+        open.push(Entry(0, baseStationId));
+    }
+    while (!open.empty())
+    {
+        Entry top = open.top();
+        open.pop();
+        int u = top.second;
+        if (top.first > shortestPathDistance[u])
+            continue;
+        for (int e = graph.getEdgeBegin(u); e < graph.getEdgeEnd(u); ++e)
+        {
+            int v = graph.getNeighborId(e);
+            double d = graph.getEdgeSquaredDistance(e) + shortestPathDistance[u];
+            if (d < shortestPathDistance[v])
+            {
+                shortestPathDistance[v] = d;
+                via[v] = u;
+                open.push(Entry(d, v));
+            }
+        }
+    }
+
+    // family phase, as in Host::initFamilyProcess
+    for (int i = 0; i < numHosts; ++i)
+    {
+        int v = via[i];
+        if (v == i || v == -1 || graph.getDistance(i, v) > maxRange)
+            parent[i] = -1;
+        else
+            parent[i] = v;
+    }
+    buildChildIndex();
+    hasTree = true;
+}
+
+void VmerSolver::buildChildIndex()
+{
+    childStart.assign(numHosts + 1, 0);
+    for (int i = 0; i < numHosts; ++i)
+        if (parent[i] != -1)
+            childStart[parent[i] + 1]++;
+    for (int i = 0; i < numHosts; ++i)
+        childStart[i + 1] += childStart[i];
+    childIds.resize(childStart[numHosts]);
+    std::vector<int> fill(childStart.begin(), childStart.end() - 1);
+    for (int i = 0; i < numHosts; ++i)
+        if (parent[i] != -1)
+            childIds[fill[parent[i]]++] = i;
+}
+
+void VmerSolver::selectPartners()
+{
+    // every host hears exactly one dct or pts from its parent, and what it
+    // computes depends only on that message, so any visiting order will do
+    std::fill(partner.begin(), partner.end(), -1);
+    std::fill(parentsPartner.begin(), parentsPartner.end(), -1);
+    std::fill(pairingInput.begin(), pairingInput.end(), PairingInput());
+    partnerChanged.clear();
+    numPairingsRedone = 0;
+    if (baseStationId < 0 || baseStationId >= numHosts)
+        return;
+    for (int k = childStart[baseStationId]; k < childStart[baseStationId + 1]; ++k)
+        deliver(childIds[k], PairingInput{DCT_UNPAIRED, 0});
+}
+
+void VmerSolver::deliver(int u, PairingInput input)
+{
+    if (input == pairingInput[u] && !pairingDirty[u])
+    {
+        // same message as before: u would send the same to its children
+        if (pairingDirtyBelow[u])
+        {
+            pairingDirtyBelow[u] = false;
+            for (int k = childStart[u]; k < childStart[u + 1]; ++k)
+                deliver(childIds[k], pairingInput[childIds[k]]);
+        }
+        return;
+    }
+    pairingInput[u] = input;
+    pairingDirty[u] = pairingDirtyBelow[u] = false;
+    numPairingsRedone++;
+    if (input.kind == PTS)
+        recvPTS(u, input.id);
+    else
+        recvDCT(u, input.kind == DCT_PAIRED, input.id);
+}
+
+void VmerSolver::update(const std::vector<int>& hosts, const std::vector<int>& changedRows)
+{
+    // nothing to repair yet
+    if (!hasTree)
+    {
+        solve();
+        return;
+    }
+    std::vector<int> oldParent = parent;
+    std::vector<int> reparented;
+    partnerChanged.clear();
+    repairTree(hosts, reparented);
+
+    // hosts whose dct/pts handler may compute something else from the
+    // same message: new parent or children, or a changed link length
+    // (the handler of u also reads links of its parent, so the children
+    // of every changed row count too)
+    std::vector<int> dirty = changedRows;
+    for (int r : changedRows)
+        dirty.insert(dirty.end(), childIds.begin() + childStart[r], childIds.begin() + childStart[r + 1]);
+    for (int u : reparented)
+    {
+        dirty.push_back(u);
+        if (oldParent[u] != -1)
+            dirty.push_back(oldParent[u]);
+        if (parent[u] != -1)
+            dirty.push_back(parent[u]);
+    }
+    for (int u : dirty)
+    {
+        pairingDirty[u] = true;
+        for (int v = parent[u]; v != -1 && !pairingDirtyBelow[v]; v = parent[v])
+            pairingDirtyBelow[v] = true;
+    }
+
+    // hosts cut off from the base station hear nothing
+    for (int u = 0; u < numHosts; ++u)
+    {
+        if (parent[u] == -1 && pairingInput[u].kind != NO_INPUT)
+        {
+            if (partner[u] != -1)
+                partnerChanged.push_back(u);
+            pairingInput[u] = PairingInput();
+            partner[u] = parentsPartner[u] = -1;
+        }
+    }
+    numPairingsRedone = 0;
+    if (baseStationId >= 0 && baseStationId < numHosts)
+        for (int k = childStart[baseStationId]; k < childStart[baseStationId + 1]; ++k)
+            deliver(childIds[k], PairingInput{DCT_UNPAIRED, 0});
+    for (int u : dirty)
+        pairingDirty[u] = false;
+    std::fill(pairingDirtyBelow.begin(), pairingDirtyBelow.end(), false);
+
+    // hosts whose rtd handler reads a changed link, parent or partner: the
+    // path terms of u read its parent and its partner, their parents and
+    // partners, and the parent of its partner's parent
+    std::vector<int> rtdDirty;
+    auto addReaders = [&](int c) {
+        rtdDirty.push_back(c);
+        if (partner[c] != -1)
+        {
+            rtdDirty.push_back(partner[c]);
+            rtdDirty.insert(rtdDirty.end(), childIds.begin() + childStart[partner[c]], childIds.begin() + childStart[partner[c] + 1]);
+        }
+        for (int k = childStart[c]; k < childStart[c + 1]; ++k)
+        {
+            int g = childIds[k];
+            rtdDirty.push_back(g);
+            if (partner[g] != -1)
+                rtdDirty.push_back(partner[g]);
+            for (int l = childStart[g]; l < childStart[g + 1]; ++l)
+            {
+                rtdDirty.push_back(childIds[l]);
+                if (partner[childIds[l]] != -1)
+                    rtdDirty.push_back(partner[childIds[l]]);
+            }
+        }
+    };
+    for (int c : changedRows)
+        addReaders(c);
+    for (int c : reparented)
+        addReaders(c);
+    for (int c : partnerChanged)
+        addReaders(c);
+    // a tree-scoped rtd goes to the hosts that wait for it, which depends
+    // on their parents
+    if (treeScopedRouteDiscovery)
+        for (int c : reparented)
+            for (int e = graph.getEdgeBegin(c); e < graph.getEdgeEnd(c); ++e)
+                rtdDirty.push_back(graph.getNeighborId(e));
+    std::sort(rtdDirty.begin(), rtdDirty.end());
+    rtdDirty.erase(std::unique(rtdDirty.begin(), rtdDirty.end()), rtdDirty.end());
+
+    rediscoverRoutes(rtdDirty);
+    convergecast();
+}
+
+void VmerSolver::repairTree(const std::vector<int>& hosts, std::vector<int>& reparented)
+{
+    // the paths that got longer all go through an updated host: invalidate
+    // its subtree and reach those hosts again from their valid neighbors
+    std::vector<bool> invalid(numHosts, false);
+    std::vector<int> region, stack;
+    for (int m : hosts)
+    {
+        if (!invalid[m])
+        {
+            invalid[m] = true;
+            stack.push_back(m);
+        }
+    }
+    while (!stack.empty())
+    {
+        int u = stack.back();
+        stack.pop_back();
+        region.push_back(u);
+        for (int k = childStart[u]; k < childStart[u + 1]; ++k)
+        {
+            if (!invalid[childIds[k]])
+            {
+                invalid[childIds[k]] = true;
+                stack.push_back(childIds[k]);
+            }
+        }
+    }
+
+    std::vector<int> previousParent(numHosts, -2);
+    std::vector<int> touched;
+    auto setParent = [&](int v, int u) {
+        if (previousParent[v] == -2)
+        {
+            previousParent[v] = parent[v];
+            touched.push_back(v);
+        }
+        parent[v] = u;
+    };
+    typedef std::pair<double, int> Entry;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> open;
+    for (int u : region)
+    {
+        setParent(u, -1);
+        shortestPathDistance[u] = u == baseStationId ? 0 : INFINITY;
+    }
+    for (int u : region)
+    {
+        if (u != baseStationId)
+        {
+            // link costs are added as in buildTree(), so the sums are the same
+            for (int e = graph.getEdgeBegin(u); e < graph.getEdgeEnd(u); ++e)
+            {
+                int v = graph.getNeighborId(e);
+                double d = graph.getEdgeSquaredDistance(e) + shortestPathDistance[v];
+                if (!invalid[v] && d < shortestPathDistance[u])
+                {
+                    shortestPathDistance[u] = d;
+                    setParent(u, v);
+                }
+            }
+        }
+        if (shortestPathDistance[u] != INFINITY)
+            open.push(Entry(shortestPathDistance[u], u));
+    }
+    while (!open.empty())
+    {
+        Entry top = open.top();
+        open.pop();
+        int u = top.second;
+        if (top.first > shortestPathDistance[u])
+            continue;
+        for (int e = graph.getEdgeBegin(u); e < graph.getEdgeEnd(u); ++e)
+        {
+            int v = graph.getNeighborId(e);
+            double d = graph.getEdgeSquaredDistance(e) + shortestPathDistance[u];
+            if (d < shortestPathDistance[v])
+            {
+                shortestPathDistance[v] = d;
+                setParent(v, u);
+                open.push(Entry(d, v));
+            }
+        }
+    }
+
+    for (int v : touched)
+        if (parent[v] != previousParent[v])
+            reparented.push_back(v);
+    numReparented = reparented.size();
+    buildChildIndex();
+}
+
+int VmerSolver::choosePartner(int u, bool paired, int pairedId, double& maximalWeight) const
+{
+    // only the SISO energy to the candidate depends on it: the cooperative
+    // terms are taken with w = partner[u], so they are hoisted out of the
+    // loop and the weights of all children come from one batch kernel
+    int v = parent[u];
+    double cooperativeEnergy;
+    if (!paired)
+    {
+        cooperativeEnergy = linkEnergyPerBit<2, 1>(u, v, 0);
+    }
+    else
+    {
+        int t = pairedId;
+        double p_uw_v = linkEnergyPerBit<2, 1>(u, v, 0);
+        double p_uw_t = linkEnergyPerBit<2, 1>(u, t, 0);
+        double p_uw_vt = linkEnergyPerBit<2, 2>(u, v, t);
+        cooperativeEnergy = std::min(std::min(p_uw_v, p_uw_t), p_uw_vt);
+    }
+    double parentEnergy = linkEnergyPerBit<1, 1>(u, v, 0);
+
+    int begin = childStart[u];
+    int n = childStart[u + 1] - begin;
+    childSquaredDistance.resize(n);
+    childWeight.resize(n);
+    for (int k = 0; k < n; ++k)
+        childSquaredDistance[k] = squaredDistance(u, childIds[begin + k]);
+    radioModel.pairingWeights(childSquaredDistance.data(), n, 0.5 - gamma, parentEnergy, cooperativeEnergy, childWeight.data());
+
+    maximalWeight = -INFINITY;
+    int maximalWeightId = -1;
+    for (int k = 0; k < n; ++k)
+    {
+        if (childWeight[k] > maximalWeight)
+        {
+            maximalWeight = childWeight[k];
+            maximalWeightId = childIds[begin + k];
+        }
+    }
+    return maximalWeightId;
+}
+
+void VmerSolver::recvDCT(int u, bool paired, int pairedId)
+{
+    // u may have handled another message in an earlier solve or update
+    int previousPartner = partner[u];
+    partner[u] = parentsPartner[u] = -1;
+    if (paired)
+        parentsPartner[u] = pairedId;
+    double maximalWeight;
+    int maximalWeightId = choosePartner(u, paired, pairedId, maximalWeight);
+
+    if (maximalWeight > 0)
+    {
+        int w = maximalWeightId;
+        partner[u] = w;
+        deliver(w, PairingInput{PTS, u});
+        for (int k = childStart[u]; k < childStart[u + 1]; ++k)
+            if (childIds[k] != w)
+                deliver(childIds[k], PairingInput{DCT_PAIRED, w});
+    }
+    else
+    {
+        for (int k = childStart[u]; k < childStart[u + 1]; ++k)
+            deliver(childIds[k], PairingInput{DCT_UNPAIRED, 0});
+    }
+    if (partner[u] != previousPartner)
+        partnerChanged.push_back(u);
+}
+
+void VmerSolver::recvPTS(int u, int sender)
+{
+    if (partner[u] != sender)
+        partnerChanged.push_back(u);
+    parentsPartner[u] = -1;
+    for (int k = childStart[u]; k < childStart[u + 1]; ++k)
+        deliver(childIds[k], PairingInput{DCT_PAIRED, sender});
+    partner[u] = sender;
+}
+
+int64_t VmerSolver::getTransmissionTicks(int sender, int target) const
+{
+    double delay = graph.getDistance(sender, target) / timing.propagationSpeed;
+    int64_t delayTicks = timing.toTicks ? timing.toTicks(delay) : (int64_t)std::floor(delay * 1e12 + 0.5);
+    return delayTicks + timing.packetDurationTicks;
+}
+
+void VmerSolver::send(int sender, int target, double a, double b)
+{
+    // an rtd to a host that is not replayed repeats one it handled in the
+    // last run, or it makes the host replayed when it arrives
+    int64_t arrival = now + getTransmissionTicks(sender, target);
+    int input = rtdActive[target] ? -1 : findResentInput(target, sender, arrival, a, b);
+    enqueue(arrival, now, target, sender, a, b, RTD_PACKET, input);
+}
+
+void VmerSolver::enqueue(int64_t arrival, int64_t sent, int target, int sender, double a, double b, int kind, int input)
+{
+    queue.push_back(Packet{arrival, sent, seq++, target, sender, a, b, kind, input});
+    std::push_heap(queue.begin(), queue.end(), ArrivesLater());
+}
+
+bool VmerSolver::popPacket(Packet& pk)
+{
+    if (queue.empty())
+        return false;
+    std::pop_heap(queue.begin(), queue.end(), ArrivesLater());
+    pk = queue.back();
+    queue.pop_back();
+    now = pk.arrival;
+    numPacketsReplayed++;
+    return true;
+}
+
+void VmerSolver::discoverRoutes()
+{
+    std::fill(tp1.begin(), tp1.end(), INFINITY);
+    std::fill(tp2.begin(), tp2.end(), INFINITY);
+    std::fill(pnum.begin(), pnum.end(), 2);
+    std::fill(rtdTerminated.begin(), rtdTerminated.end(), false);
+    std::fill(route1.begin(), route1.end(), NO_ROUTE);
+    std::fill(route2.begin(), route2.end(), NO_ROUTE);
+    for (std::vector<RtdInput>& inputs : rtdInputs)
+        inputs.clear();
+    std::fill(rtdTime.begin(), rtdTime.end(), NEVER);
+    hasRoutes = true;
+    if (baseStationId < 0 || baseStationId >= numHosts)
+        return;
+
+    // every host is replayed
+    std::fill(rtdActive.begin(), rtdActive.end(), true);
+    queue.clear();
+    now = 0;
+    for (int k = childStart[baseStationId]; k < childStart[baseStationId + 1]; ++k)
+        send(baseStationId, childIds[k], 0, INFINITY);
+    Packet pk;
+    while (popPacket(pk))
+        deliverRTD(pk);
+    std::fill(rtdActive.begin(), rtdActive.end(), false);
+}
+
+void VmerSolver::rediscoverRoutes(const std::vector<int>& dirty)
+{
+    if (!hasRoutes || baseStationId < 0 || baseStationId >= numHosts)
+    {
+        discoverRoutes();
+        return;
+    }
+
+    // Replays the dirty hosts from the start, and every other host from
+    // the first rtd that differs from what it handled in the last run: a
+    // new one, one with other costs or at another time, or one that is not
+    // sent again (RTD_CHECK). Until then it handles the same rtds as
+    // before, so those are replayed from rtdInputs; the rtds it gets from
+    // hosts that are not replayed are queued from their recorded results
+    // (RECORDED_RTD). Hosts that are never replayed keep their results.
+    rtdRun++;
+    rtdAmbiguous = false;
+    queue.clear();
+    now = 0;
+    for (int u : dirty)
+        activate(u, 0, 0, -1);
+    for (int k = childStart[baseStationId]; k < childStart[baseStationId + 1]; ++k)
+        send(baseStationId, childIds[k], 0, INFINITY);
+    Packet pk;
+    while (!rtdAmbiguous && popPacket(pk))
+    {
+        int u = pk.target;
+        if (pk.kind == RTD_CHECK)
+        {
+            if (!rtdActive[u] && rtdInputs[u][pk.input].resentIn != rtdRun)
+                activate(u, pk.arrival, pk.sent, pk.input);
+        }
+        else if (pk.kind == RECORDED_RTD)
+        {
+            // unless the sender has been replayed since, and sends anew
+            if (!rtdActive[pk.sender])
+                deliverRTD(pk);
+        }
+        else
+        {
+            if (!rtdActive[u])
+            {
+                // sent again as before, or after u terminated
+                if (pk.input != -1)
+                    continue;
+                if (rtdTime[u] != NEVER)
+                {
+                    const RtdInput& last = rtdInputs[u].back();
+                    if (std::make_pair(pk.arrival, pk.sent) > std::make_pair(last.arrival, last.sent))
+                        continue;
+                }
+                activate(u, pk.arrival, pk.sent, -1);
+            }
+            deliverRTD(pk);
+        }
+    }
+    for (int u : activeHosts)
+        rtdActive[u] = false;
+    activeHosts.clear();
+
+    // rtds that arrive and were sent at the same times are handled in send
+    // order, which only a full replay reproduces
+    if (rtdAmbiguous)
+        discoverRoutes();
+}
+
+void VmerSolver::activate(int u, int64_t since, int64_t sinceSent, int missingInput)
+{
+    if (rtdActive[u])
+        return;
+    rtdActive[u] = true;
+    activeHosts.push_back(u);
+
+    // before the rtd that arrives at since, sent at sinceSent, u handles
+    // the same rtds as in the last run
+    std::pair<int64_t, int64_t> first(since, sinceSent);
+    replayedInputs.swap(rtdInputs[u]);
+    rtdInputs[u].clear();
+    tp1[u] = tp2[u] = INFINITY;
+    pnum[u] = 2;
+    rtdTerminated[u] = false;
+    route1[u] = route2[u] = NO_ROUTE;
+    rtdTime[u] = NEVER;
+    int64_t time = now;
+    for (int k = 0; k < (int)replayedInputs.size(); ++k)
+    {
+        const RtdInput& input = replayedInputs[k];
+        std::pair<int64_t, int64_t> key(input.arrival, input.sent);
+        if (k == missingInput || key > first)
+            continue;
+        if (key == first)
+        {
+            rtdAmbiguous = true;
+            continue;
+        }
+        now = input.arrival;
+        deliverRTD(Packet{input.arrival, input.sent, 0, u, input.sender, input.pc1, input.pc2, RTD_PACKET, -1});
+    }
+    now = time;
+
+    for (int e = graph.getEdgeBegin(u); e < graph.getEdgeEnd(u); ++e)
+    {
+        int s = graph.getNeighborId(e);
+        if (rtdActive[s])
+            continue;
+        // the rtd s sends u as in the last run
+        if (rtdTime[s] != NEVER && (!treeScopedRouteDiscovery || waitsForRTD(s, u)))
+        {
+            std::pair<int64_t, int64_t> key(rtdTime[s] + getTransmissionTicks(s, u), rtdTime[s]);
+            if (key == first)
+                rtdAmbiguous = true;
+            else if (key > first)
+                enqueue(key.first, key.second, u, s, tp1[s], tp2[s], RECORDED_RTD, -1);
+        }
+        // the rtds s handled from u, which u may not send again
+        for (int k = 0; k < (int)rtdInputs[s].size(); ++k)
+        {
+            const RtdInput& input = rtdInputs[s][k];
+            if (input.sender == u)
+                enqueue(input.arrival, input.sent, s, u, 0, 0, RTD_CHECK, k);
+        }
+    }
+}
+
+int VmerSolver::findResentInput(int u, int sender, int64_t arrival, double pc1, double pc2)
+{
+    int found = -1;
+    for (int k = 0; k < (int)rtdInputs[u].size(); ++k)
+    {
+        RtdInput& input = rtdInputs[u][k];
+        if (input.arrival != arrival || input.sent != now)
+            continue;
+        if (input.sender != sender)
+            rtdAmbiguous = true;
+        else if (input.pc1 == pc1 && input.pc2 == pc2)
+        {
+            input.resentIn = rtdRun;
+            found = k;
+        }
+    }
+    return found;
+}
+
+void VmerSolver::deliverRTD(const Packet& pk)
+{
+    int u = pk.target;
+    std::vector<RtdInput>& inputs = rtdInputs[u];
+    if (!inputs.empty() && inputs.back().arrival == pk.arrival && inputs.back().sent == pk.sent)
+        rtdAmbiguous = true;
+    if (rtdTerminated[u] || parent[u] == -1)
+        return;
+    inputs.push_back(RtdInput{pk.arrival, pk.sent, pk.sender, pk.a, pk.b, 0});
+    recvRTD(u, pk.a, pk.b);
+}
+
+void VmerSolver::recvRTD(int u, double energyPC1, double energyPC2)
+{
+    if (parent[u] == -1)
+        return;
+
+    // energy_path0 is the minimum of the path terms, taken in order as
+    // std::min() would, and route0 the term that gave it
+    double energy_path0 = INFINITY;
+    int route0 = NO_ROUTE;
+    auto choose = [&](double energy, int route) {
+        if (route0 == NO_ROUTE || energy < energy_path0)
+        {
+            energy_path0 = energy;
+            route0 = route;
+        }
+    };
+    if (energyPC2 == INFINITY)
+    {
+        pnum[u] = 0;
+        if (partner[u] == -1)
+        {
+            tp2[u] = getEnergyToParentSISO(u);
+            route2[u] = PARENT_SISO;
+        }
+        else
+        {
+            choose(getPath_1_Energy(u, energyPC1), PATH_1);
+            choose(getPath_2_Energy(u, energyPC1), PATH_2);
+            choose(getPath_6_Energy(u, energyPC1), PATH_6);
+            tp2[u] = energyPC1 + getEnergyToParentMISO(u);
+            route2[u] = PARENT_MISO;
+        }
+    }
+    else
+    {
+        pnum[u]--;
+        int t = partner[parent[u]];
+        if (t == -1 || graph.getDistance(u, t) > maxRange)
+            pnum[u] = 0;
+        if (partner[u] == -1)
+        {
+            choose(getPath_1_Energy(u, energyPC1), PATH_1);
+            choose(getPath_5_Energy(u, energyPC2), PATH_5);
+        }
+        else
+        {
+            choose(getPath_1_Energy(u, energyPC1), PATH_1);
+            choose(getPath_2_Energy(u, energyPC1), PATH_2);
+            choose(getPath_6_Energy(u, energyPC1), PATH_6);
+            choose(getPath_5_Energy(u, energyPC2), PATH_5);
+            choose(getPath_8_Energy(u, energyPC2), PATH_8);
+            double miso = energyPC1 + getEnergyToParentMISO(u);
+            double mimo = energyPC2 + getEnergyToParentMIMO(u);
+            double temp = std::min(miso, mimo);
+            if (!(tp2[u] < temp))
+            {
+                tp2[u] = temp;
+                route2[u] = mimo < miso ? PARENT_MIMO : PARENT_MISO;
+            }
+        }
+    }
+    if (pnum[u] == 0)
+    {
+        rtdTime[u] = now;
+        tp1[u] = energy_path0;
+        route1[u] = route0;
+        for (int e = graph.getEdgeBegin(u); e < graph.getEdgeEnd(u); ++e)
+        {
+            // a terminated host drops every later rtd, whenever it arrives,
+            // so those are counted but not queued
+            int v = graph.getNeighborId(e);
+            if (treeScopedRouteDiscovery && !waitsForRTD(u, v))
+                continue;
+            if (hasTerminatedRTD(v))
+                numPacketsReplayed++;
+            else
+                send(u, v, tp1[u], tp2[u]);
+            rtdTerminated[u] = true;
+        }
+        if (treeScopedRouteDiscovery)
+            rtdTerminated[u] = true;
+    }
+}
+
+bool VmerSolver::waitsForRTD(int u, int v) const
+{
+    // as Host::waitsForRTD(): the children of u, and its siblings if u is
+    // its parent's partner
+    if (parent[v] == u)
+        return true;
+    return parent[u] != -1 && partner[parent[u]] == u && parent[v] == parent[u];
+}
+
+int VmerSolver::getReportLinks(int i, Link links[2]) const
+{
+    if (!(getReportEnergy(i) < INFINITY))
+        return 0;
+    int route = tp2[i] < tp1[i] ? route2[i] : route1[i];
+    int w = partner[i], v = parent[i];
+    int t = v == -1 ? -1 : partner[v];
+    // the arguments the getters pass to linkEnergyPerBit()
+    Link toParent = {1, 1, i, w, v, 0};
+    Link toPartner = {1, 1, i, w, w, 0};
+    switch (route)
+    {
+        case PATH_1:
+        case PARENT_SISO:
+            links[0] = toParent;
+            return 1;
+        case PATH_2:
+            links[0] = toPartner;
+            links[1] = {1, 1, w, partner[w], parent[v], 0};
+            return 2;
+        case PATH_5:
+            links[0] = {1, 2, i, w, v, t};
+            return 1;
+        case PATH_6:
+            links[0] = toPartner;
+            links[1] = {2, 1, i, w, v, 0};
+            return 2;
+        case PATH_8:
+            links[0] = toPartner;
+            links[1] = {2, 2, i, w, v, t};
+            return 2;
+        case PARENT_MISO:
+            links[0] = {2, 1, i, w, v, 0};
+            return 1;
+        case PARENT_MIMO:
+            links[0] = {2, 2, i, w, v, t};
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+void VmerSolver::convergecast()
+{
+    // vMER: every host reports min(tp1, tp2), forwarders add their own
+    std::vector<double> energy(numHosts, INFINITY);
+    for (int i = 0; i < numHosts; ++i)
+        energy[i] = getReportEnergy(i);
+    totalEnergy = gather(energy, energy);
+
+    // MTD: the same over plain SISO links to the parent
+    for (int i = 0; i < numHosts; ++i)
+        energy[i] = getReportEnergyMTD(i);
+    totalEnergyMTD = gather(energy, energy);
+}
+
+double VmerSolver::gather(const std::vector<double>& report, const std::vector<double>& relay)
+{
+    // ticks from each host to its parent, as computed by send()
+    std::vector<int64_t> hop(numHosts, 0);
+    for (int i = 0; i < numHosts; ++i)
+    {
+        if (parent[i] != -1)
+            hop[i] = getTransmissionTicks(i, parent[i]);
+    }
+
+    // the report of host i is sent at time 0 and forwarded by every host
+    // on the path, which adds relay[] unless the sum becomes infinite
+    struct Arrival
+    {
+        int64_t time;
+        int origin;
+        double energy;
+    };
+    std::vector<Arrival> arrivals;
+    for (int i = 0; i < numHosts; ++i)
+    {
+        if (parent[i] == -1)
+            continue;
+        double energy = report[i];
+        int64_t time = hop[i];
+        int u = parent[i];
+        numPacketsReplayed++;
+        while (parent[u] != -1 && energy + relay[u] != INFINITY)
+        {
+            energy += relay[u];
+            time += hop[u];
+            u = parent[u];
+            numPacketsReplayed++;
+        }
+        if (parent[u] == -1 && u == baseStationId)
+            arrivals.push_back(Arrival{time, i, energy});
+    }
+
+    // the base station adds the reports in the kernel's event order: by
+    // arrival time, ties by send order. A forwarded copy is sent when the
+    // previous hop is processed, so on a tie the hops before are compared
+    // the same way, back to the initial sends, which go out in host order.
+    auto before = [this, &hop](const Arrival& a, const Arrival& b) {
+        if (a.time != b.time)
+            return a.time < b.time;
+        std::vector<int64_t> pathA, pathB;  // arrival times hop by hop
+        for (int u = a.origin, t = 0; parent[u] != -1; u = parent[u])
+            pathA.push_back(t += hop[u]);
+        for (int u = b.origin, t = 0; parent[u] != -1; u = parent[u])
+            pathB.push_back(t += hop[u]);
+        for (int ka = pathA.size() - 1, kb = pathB.size() - 1; ; --ka, --kb)
+        {
+            if (ka == 0 || kb == 0)
+                return ka == kb ? a.origin < b.origin : ka == 0;
+            if (pathA[ka - 1] != pathB[kb - 1])
+                return pathA[ka - 1] < pathB[kb - 1];
+        }
+    };
+    std::sort(arrivals.begin(), arrivals.end(), before);
+    double total = 0;
+    for (const Arrival& a : arrivals)
+        total += a.energy;
+    return total;
+}
+
+double VmerSolver::calculateEnergyConsumptionPerBit(int u, int v, int t, int numTx, int numRx) const
+{
+    // see Host::calculateEnergyConsumptionPerBit; w is always u's partner
+    auto d2 = [this](int a, int b) { return squaredDistance(a, b); };
+    return energyPerBitOfMode(radioModel, numTx, numRx, d2, u, partner[u], v, t);
+}
+
+double VmerSolver::getPath_1_Energy(int u, double pc1) const
+{
+    return parent[u] != -1 ? pc1 + getEnergyToParentSISO(u) : INFINITY;
+}
+
+double VmerSolver::getPath_2_Energy(int u, double pc1) const
+{
+    return partner[u] != -1 ? pc1 + getEnergyToPartnerSISO(u) + getEnergyToParentsParentSISO(partner[u]) : INFINITY;
+}
+
+double VmerSolver::getPath_3_Energy(int u, double pc1) const
+{
+    int t = parentsPartner[u];
+    return t != -1 ? pc1 + getEnergyToParentSISO(t) + getEnergyToParentsPartnerSISO(u) : INFINITY;
+}
+
+double VmerSolver::getPath_4_Energy(int u, double pc1) const
+{
+    int t = parentsPartner[u];
+    if (partner[u] == -1)
+        return INFINITY;
+    return pc1 + (t == -1 ? INFINITY : getEnergyToParentSISO(t)) + getEnergyToPartnerSISO(u) + getEnergyToParentsParentsPartnerSISO(partner[u]);
+}
+
+double VmerSolver::getPath_5_Energy(int u, double pc2) const
+{
+    return getEnergyToParentSIMO(u) + pc2;
+}
+
+double VmerSolver::getPath_6_Energy(int u, double pc1) const
+{
+    return getEnergyToPartnerSISO(u) + getEnergyToParentMISO(u) + pc1;
+}
+
+double VmerSolver::getPath_7_Energy(int u, double pc1) const
+{
+    int t = parent[u] == -1 ? -1 : partner[parent[u]];
+    return getEnergyToPartnerSISO(u) + getEnergyToParentsPartnerMISO(u) + pc1 + (t == -1 ? INFINITY : getEnergyToParentSISO(t));
+}
+
+double VmerSolver::getPath_8_Energy(int u, double pc2) const
+{
+    return getEnergyToPartnerSISO(u) + getEnergyToParentMIMO(u) + pc2;
+}
+
+double VmerSolver::getEnergyToParentSISO(int u) const
+{
+    return parent[u] == -1 ? INFINITY : linkEnergyPerBit<1, 1>(u, parent[u], 0);
+}
+
+double VmerSolver::getEnergyToParentsParentSISO(int u) const
+{
+    int v = parent[u];
+    return linkEnergyPerBit<1, 1>(u, v == -1 ? -1 : parent[v], 0);
+}
+
+double VmerSolver::getEnergyToParentsPartnerSISO(int u) const
+{
+    int v = parent[u];
+    if (v == -1 || partner[v] == -1)
+        return INFINITY;
+    return linkEnergyPerBit<1, 1>(u, partner[v], 0);
+}
+
+double VmerSolver::getEnergyToParentsParentsPartnerSISO(int u) const
+{
+    // as in Host, the receiver is host 0 rather than that partner
+    int v = parent[u];
+    if (v == -1 || partner[v] == -1)
+        return INFINITY;
+    return linkEnergyPerBit<1, 1>(u, 0, 0);
+}
+
+double VmerSolver::getEnergyToPartnerSISO(int u) const
+{
+    return partner[u] == -1 ? INFINITY : linkEnergyPerBit<1, 1>(u, partner[u], 0);
+}
+
+double VmerSolver::getEnergyToParentSIMO(int u) const
+{
+    int v = parent[u];
+    if (v == -1 || partner[v] == -1)
+        return INFINITY;
+    return linkEnergyPerBit<1, 2>(u, v, partner[v]);
+}
+
+double VmerSolver::getEnergyToParentMISO(int u) const
+{
+    return linkEnergyPerBit<2, 1>(u, parent[u], 0);
+}
+
+double VmerSolver::getEnergyToParentsPartnerMISO(int u) const
+{
+    int v = parent[u];
+    if (v == -1 || partner[v] == -1)
+        return INFINITY;
+    return linkEnergyPerBit<2, 1>(u, 0, partner[v]);
+}
+
+double VmerSolver::getEnergyToParentMIMO(int u) const
+{
+    int v = parent[u];
+    if (v == -1 || partner[v] == -1)
+        return INFINITY;
+    return linkEnergyPerBit<2, 2>(u, v, partner[v]);
+}
+
+}; //namespace
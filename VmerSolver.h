@@ -0,0 +1,299 @@
+//
+// This file is part of an OMNeT++/OMNEST simulation example.
+//
+// Copyright (C) 1992-2015 Andras Varga
+//
+// This file is distributed WITHOUT ANY WARRANTY. See the file
+// `license' for details on this and other legal matters.
+//
+
+#ifndef __ALOHA_VMERSOLVER_H_
+#define __ALOHA_VMERSOLVER_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "NeighborGraph.h"
+#include "RadioModel.h"
+
+namespace aloha {
+
+/**
+ * Centralized version of the Host protocol: computes the shortest-path
+ * tree, the detection/partner-selection pairing, the vMER route discovery
+ * and both energy convergecasts directly on the neighbor graph, without
+ * simulating the control packets.
+ *
+ * Every per-host computation mirrors the corresponding Host method
+ * (recvDCT, recvRTD, getPath_N_Energy, ...) term by term, so the results
+ * equal those of the message-driven run. The route-discovery and energy
+ * phases depend on the order in which packets arrive. Route discovery is
+ * replayed with a small event queue that uses the same arrival times
+ * (propagation delay plus packet duration, in simulation time ticks) and
+ * the same tie-breaking (send order) as the simulation kernel. In the
+ * convergecasts every report travels alone along its path to the base
+ * station, so each is folded along its path and only the arrival order
+ * at the base station, which fixes the order of the sum, is derived from
+ * the same times and tie-breaking.
+ *
+ * After a solve, update() takes a topology change (hosts that moved or
+ * failed) and repairs the tree, the pairing and the route discovery only
+ * where they depend on the changed links, instead of solving from scratch.
+ *
+ * This class has no OMNeT++ dependency on purpose; see PhaseCoordinator
+ * for the module that runs it.
+ */
+class VmerSolver
+{
+  public:
+    struct Timing
+    {
+        double propagationSpeed = 299792458.0;  // m/s, as in Host
+        int64_t packetDurationTicks = 0;        // duration of a control packet
+        std::function<int64_t(double)> toTicks; // seconds to simulation time ticks; picoseconds if unset
+    };
+
+    VmerSolver(const NeighborGraph& graph, const RadioModel& radioModel, double maxRange, int baseStationId, double gamma);
+
+    void setTiming(const Timing& timing) { this->timing = timing; }
+
+    /**
+     * Route discovery scope (the routeDiscoveryScope parameter): with
+     * false, as by default, a host sends its rtd to every neighbor; with
+     * true only to the hosts that wait for it (see waitsForRTD()).
+     */
+    void setTreeScopedRouteDiscovery(bool treeScoped) { treeScopedRouteDiscovery = treeScoped; }
+
+    /**
+     * Uses the given tree instead of computing one; parent is -1 for the
+     * base station and unreachable hosts.
+     */
+    void setTree(const std::vector<int>& parent, const std::vector<double>& shortestPathDistance);
+
+    /**
+     * Runs all phases; the tree is computed unless setTree() was called.
+     */
+    void solve();
+
+    // the individual phases, in the order solve() runs them
+    void buildTree();           // location, Bellman-Ford and family phases
+    void selectPartners();      // detection and partner-selection phase
+    void discoverRoutes();      // vMER route discovery
+    void convergecast();        // vMER and MTD energy convergecasts
+
+    /**
+     * Brings a solved network up to date after the given hosts moved or
+     * failed. The graph must already have been updated (see
+     * NeighborGraph::update()), and changedRows must list every host whose
+     * row changed. Shortest paths are recomputed only for the subtrees of
+     * the updated hosts, with Dijkstra restarted from their boundary, and
+     * the detection phase only for hosts whose parent, children, incoming
+     * dct/pts or link lengths changed, and below them as far as the
+     * messages they send change. Route discovery is replayed only for the
+     * hosts whose rtd handler reads a changed link, parent or partner, and
+     * for those that then receive an rtd other than in the last run, each
+     * from the time its input first differs; the others keep their route
+     * costs. The convergecasts are rerun.
+     */
+    void update(const std::vector<int>& hosts, const std::vector<int>& changedRows);
+    int getNumReparented() const { return numReparented; }         // by the last update()
+    int getNumPairingsRedone() const { return numPairingsRedone; } // dct/pts handled by the last update() or selectPartners()
+
+    int getNumHosts() const { return numHosts; }
+    int getParentId(int i) const { return parent[i]; }
+    int getPartnerId(int i) const { return partner[i]; }
+    double getShortestPathDistance(int i) const { return shortestPathDistance[i]; }
+    double getTp1(int i) const { return tp1[i]; }
+    double getTp2(int i) const { return tp2[i]; }
+
+    /**
+     * Energy per bit the vMER and the MTD convergecast charge for every
+     * report host i sends or relays; see DataGathering.
+     */
+    double getReportEnergy(int i) const { return std::min(tp1[i], tp2[i]); }
+    double getReportEnergyMTD(int i) const { return getEnergyToParentSISO(i); }
+
+    /**
+     * A link of a report hop: the arguments of linkEnergyPerBit<numTx,
+     * numRx>(u, v, t), with w the partner of u.
+     */
+    struct Link
+    {
+        int numTx, numRx;
+        int u, w, v, t;
+    };
+
+    /**
+     * The links over which host i sends its vMER report towards its
+     * parent: those of the path term that gave getReportEnergy(i), without
+     * the pc1 or pc2 it was added to. Returns their number (at most 2), or
+     * 0 if getReportEnergy(i) is infinite.
+     */
+    int getReportLinks(int i, Link links[2]) const;
+
+    double getTotalEnergy() const { return totalEnergy; }
+    double getTotalEnergyMTD() const { return totalEnergyMTD; }
+    long getNumPacketsReplayed() const { return numPacketsReplayed; }
+
+    /**
+     * The per-host kernels of the phases, evaluated on the current state;
+     * public for the benchmarks. calculateEnergyConsumptionPerBit() is the
+     * one of Host with u as the transmitting host and u's partner as w;
+     * linkEnergyPerBit() is the same for a mode fixed at compile time,
+     * which is what the getters use.
+     */
+    double calculateEnergyConsumptionPerBit(int u, int v, int t, int numTx, int numRx) const;
+    template<int NumTx, int NumRx>
+    double linkEnergyPerBit(int u, int v, int t) const
+    {
+        auto d2 = [this](int a, int b) { return squaredDistance(a, b); };
+        return EnergyModel<NumTx, NumRx>::energyPerBit(radioModel, d2, u, partner[u], v, t);
+    }
+    double getPath_1_Energy(int u, double pc1) const;   // u --> v --> ... --> z
+    double getPath_2_Energy(int u, double pc1) const;   // u --> w --> v --> ... --> z
+    double getPath_3_Energy(int u, double pc1) const;   // u --> t --> ... --> z
+    double getPath_4_Energy(int u, double pc1) const;   // u --> w --> t --> ... --> z
+    double getPath_5_Energy(int u, double pc2) const;   // u --> {v, t} --> ... --> z
+    double getPath_6_Energy(int u, double pc1) const;   // u --> {u, w} --> v --> ... --> z
+    double getPath_7_Energy(int u, double pc1) const;   // u --> {u, w} --> t --> ... --> z
+    double getPath_8_Energy(int u, double pc2) const;   // u --> {u, w} --> {v, t} --> ... --> z
+
+    /**
+     * The weight loop of Host::recvDCT: the child of u that maximizes the
+     * pairing weight W(u, w), or -1 if u has no children.
+     */
+    int choosePartner(int u, bool paired, int pairedId, double& maximalWeight) const;
+
+  private:
+    struct Packet
+    {
+        int64_t arrival;
+        int64_t sent;
+        long seq;       // send order, breaks ties between equal arrival times
+        int target;
+        int sender;
+        double a, b;    // pc1 and pc2, or the energy
+        int kind;       // RTD_PACKET, RECORDED_RTD or RTD_CHECK
+        int input;      // index into rtdInputs[target], or -1
+    };
+    struct ArrivesLater
+    {
+        // a packet sent later also has a larger seq, so comparing the send
+        // times first changes nothing, but also orders the packets that
+        // rediscoverRoutes() queues out of send order
+        bool operator()(const Packet& p, const Packet& q) const
+        {
+            if (p.arrival != q.arrival)
+                return p.arrival > q.arrival;
+            return p.sent != q.sent ? p.sent > q.sent : p.seq > q.seq;
+        }
+    };
+
+    const NeighborGraph& graph;
+    const RadioModel& radioModel;
+    double maxRange;
+    int baseStationId;
+    double gamma;
+    int numHosts;
+    Timing timing;
+    bool treeScopedRouteDiscovery = false;
+    bool hasTree = false;
+
+    // per-host protocol state, named after the Host members
+    std::vector<int> parent, partner, parentsPartner;
+    std::vector<double> shortestPathDistance;
+    std::vector<int> childStart, childIds;  // children of i: childIds[childStart[i]..childStart[i+1])
+    std::vector<double> tp1, tp2;
+    std::vector<int> pnum;
+    std::vector<bool> rtdTerminated;
+
+    // the term that gave tp1 and tp2, see getReportLinks()
+    enum Route { NO_ROUTE, PATH_1, PATH_2, PATH_5, PATH_6, PATH_8, PARENT_SISO, PARENT_MISO, PARENT_MIMO };
+    std::vector<int> route1, route2;
+
+    // what each host handled in the last route discovery, so that update()
+    // replays a host only from where that changes; see rediscoverRoutes()
+    struct RtdInput
+    {
+        int64_t arrival;
+        int64_t sent;
+        int sender;
+        double pc1, pc2;
+        long resentIn;  // rediscovery run in which it was sent again unchanged
+    };
+    enum { RTD_PACKET, RECORDED_RTD, RTD_CHECK };
+    std::vector<std::vector<RtdInput>> rtdInputs;
+    std::vector<int64_t> rtdTime;   // when each host terminated, INT64_MAX if it did not
+    std::vector<bool> rtdActive;    // replayed in the current run
+    std::vector<int> activeHosts, partnerChanged;
+    std::vector<RtdInput> replayedInputs;
+    long rtdRun = 0;
+    bool rtdAmbiguous = false;      // simultaneous rtds whose order is unknown
+    bool hasRoutes = false;
+
+    // the dct or pts each host received in the detection phase; update()
+    // handles a host again only if it changes or the host is marked dirty
+    enum { NO_INPUT, DCT_UNPAIRED, DCT_PAIRED, PTS };
+    struct PairingInput
+    {
+        int kind;
+        int id;         // pairedId of a dct, sender of a pts
+        PairingInput(int kind = NO_INPUT, int id = 0) : kind(kind), id(id) {}
+        bool operator==(const PairingInput& o) const { return kind == o.kind && id == o.id; }
+    };
+    std::vector<PairingInput> pairingInput;
+    std::vector<bool> pairingDirty, pairingDirtyBelow;
+    int numReparented = 0;
+    int numPairingsRedone = 0;
+
+    // scratch arrays of choosePartner(), one entry per child
+    mutable std::vector<double> childSquaredDistance, childWeight;
+    double totalEnergy = 0;
+    double totalEnergyMTD = 0;
+
+    // event queue of the replayed phases
+    std::vector<Packet> queue;
+    int64_t now = 0;
+    long seq = 0;
+    long numPacketsReplayed = 0;
+
+    void buildChildIndex();
+    int64_t getTransmissionTicks(int sender, int target) const;
+    void send(int sender, int target, double a, double b);
+    void enqueue(int64_t arrival, int64_t sent, int target, int sender, double a, double b, int kind, int input);
+    bool popPacket(Packet& pk);
+
+    void repairTree(const std::vector<int>& hosts, std::vector<int>& reparented);
+    void deliver(int u, PairingInput input);
+    double gather(const std::vector<double>& report, const std::vector<double>& relay);
+
+    void recvDCT(int u, bool paired, int pairedId);
+    void recvPTS(int u, int sender);
+    void rediscoverRoutes(const std::vector<int>& dirty);
+    void activate(int u, int64_t since, int64_t sinceSent, int missingInput);
+    int findResentInput(int u, int sender, int64_t arrival, double pc1, double pc2);
+    void deliverRTD(const Packet& pk);
+    // a host that is not replayed and terminated just now may still be
+    // replayed by an rtd of this instant that is not sent again
+    bool hasTerminatedRTD(int u) const { return rtdActive[u] ? rtdTerminated[u] : rtdTime[u] < now; }
+    void recvRTD(int u, double pc1, double pc2);
+    bool waitsForRTD(int u, int v) const;
+
+    double squaredDistance(int a, int b) const { return (a == -1 || b == -1) ? INFINITY : graph.getSquaredDistance(a, b); }
+
+    double getEnergyToParentSISO(int u) const;
+    double getEnergyToParentsParentSISO(int u) const;
+    double getEnergyToParentsPartnerSISO(int u) const;
+    double getEnergyToParentsParentsPartnerSISO(int u) const;
+    double getEnergyToPartnerSISO(int u) const;
+    double getEnergyToParentSIMO(int u) const;
+    double getEnergyToParentMISO(int u) const;
+    double getEnergyToParentsPartnerMISO(int u) const;
+    double getEnergyToParentMIMO(int u) const;
+};
+
+}; //namespace
+
+#endif
@@ -0,0 +1,407 @@
+//
+// This file is part of an OMNeT++/OMNEST simulation example.
+//
+// Copyright (C) 1992-2015 Andras Varga
+//
+// This file is distributed WITHOUT ANY WARRANTY. See the file
+// `license' for details on this and other legal matters.
+//
+
+//
+// Microbenchmarks of the numerical kernels: the energy-per-bit model in
+// its four antenna modes (selected at run and at compile time), the
+// eight path energies of the vMER route discovery, the pairing loop of
+// the detection phase and a data-gathering round. They run on synthetic
+// topologies with the host density of omnetpp.ini (100 hosts on 800m x
+// 800m), through VmerSolver, which mirrors the Host code without needing
+// the simulation kernel.
+//
+// With -e N, it instead applies N topology epochs (one host fails and five
+// move 10m each) through VmerSolver::update() and checks every epoch
+// against a fresh solve of the same topology: parents, partners, route
+// costs and both totals must be identical. It prints the time per epoch
+// of both and exits with status 1 on any difference.
+//
+// Every run first checks the batch kernels of RadioModel (energyPerBit()
+// over n links, pairingWeights()) against their scalar forms on the links
+// of each topology, and exits with status 1 if any result differs in a
+// single bit: the SIMD lanes and the scalar tail must round alike.
+//
+// Usage: vmerbench [-t seconds per benchmark] [-e epochs] [hosts...]
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "DataGathering.h"
+#include "EnergyTable.h"
+#include "NeighborGraph.h"
+#include "RadioModel.h"
+#include "SpatialGrid.h"
+#include "VmerSolver.h"
+
+using namespace std;
+using namespace aloha;
+
+// every allocation of the process is counted, so a kernel that starts
+// allocating shows up as a nonzero allocs/op
+static long numAllocations = 0;
+
+void *operator new(size_t size)
+{
+    numAllocations++;
+    if (void *p = malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+void *operator new[](size_t size) { return operator new(size); }
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+
+static volatile double sink;    // keeps the results alive
+
+struct Topology
+{
+    std::vector<double> x, y;
+    SpatialGrid grid;
+    NeighborGraph graph;
+};
+
+static void placeHosts(Topology& topo, int numHosts, double maxRange)
+{
+    double square = 800 * std::sqrt(numHosts / 100.0);
+    std::mt19937 rng(numHosts);
+    std::uniform_real_distribution<double> coordinate(0, square);
+    topo.x.resize(numHosts);
+    topo.y.resize(numHosts);
+    for (int i = 0; i < numHosts; ++i)
+    {
+        topo.x[i] = coordinate(rng);
+        topo.y[i] = coordinate(rng);
+    }
+    topo.grid.build(topo.x, topo.y, maxRange);
+    topo.graph.build(topo.x, topo.y, topo.grid, maxRange);
+}
+
+/**
+ * Compares the batch kernels of RadioModel with their scalar forms on the
+ * links of a numHosts topology (single links and sums of two, so that
+ * every mode sees realistic distances); returns the number of results
+ * that differ.
+ */
+static int checkBatchKernels(int numHosts)
+{
+    const double maxRange = 200;
+    const double gamma = 0.1;
+    Topology topo;
+    placeHosts(topo, numHosts, maxRange);
+    RadioModel radioModel;
+    std::vector<double> sums;
+    for (int u = 0; u < numHosts; ++u)
+    {
+        for (int e = topo.graph.getEdgeBegin(u); e < topo.graph.getEdgeEnd(u); ++e)
+        {
+            double d2 = topo.graph.getSquaredDistance(u, topo.graph.getNeighborId(e));
+            sums.push_back(d2);
+            if (e + 1 < topo.graph.getEdgeEnd(u))
+                sums.push_back(d2 + topo.graph.getSquaredDistance(u, topo.graph.getNeighborId(e + 1)));
+        }
+    }
+    int n = sums.size();
+    std::vector<double> batch(n);
+    int differences = 0;
+    for (int numTx = 1; numTx <= 2; ++numTx)
+    {
+        for (int numRx = 1; numRx <= 2; ++numRx)
+        {
+            radioModel.energyPerBit(numTx, numRx, sums.data(), batch.data(), n);
+            for (int i = 0; i < n; ++i)
+                if (batch[i] != radioModel.energyPerBit(numTx, numRx, sums[i]))
+                    differences++;
+        }
+    }
+    double parentEnergy = radioModel.energyPerBit<1, 1>(maxRange * maxRange);
+    double cooperativeEnergy = radioModel.energyPerBit<2, 1>(maxRange * maxRange);
+    radioModel.pairingWeights(sums.data(), n, 0.5 - gamma, parentEnergy, cooperativeEnergy, batch.data());
+    for (int i = 0; i < n; ++i)
+        if (batch[i] != (0.5 - gamma) * radioModel.energyPerBit<1, 1>(sums[i]) + parentEnergy - cooperativeEnergy)
+            differences++;
+    if (differences > 0)
+        fprintf(stderr, "%d batch kernel results differ from the scalar form on %d links of %d hosts\n", differences, n, numHosts);
+    return differences;
+}
+
+/**
+ * Runs pass() (which performs opsPerPass operations) until minTime has
+ * elapsed, and prints the time and allocations per operation.
+ */
+static void run(const char *name, int numHosts, long opsPerPass, double minTime, const std::function<void()>& pass)
+{
+    if (opsPerPass == 0)
+    {
+        printf("%-24s %8d %12s %12s\n", name, numHosts, "-", "-");
+        return;
+    }
+    pass();     // warm up
+    long passes = 0;
+    long allocationsBefore = numAllocations;
+    auto start = std::chrono::steady_clock::now();
+    double elapsed = 0;
+    do
+    {
+        pass();
+        passes++;
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    } while (elapsed < minTime);
+    long allocations = numAllocations - allocationsBefore;
+    double ops = (double)passes * opsPerPass;
+    printf("%-24s %8d %12.2f %12.3f\n", name, numHosts, elapsed * 1e9 / ops, allocations / ops);
+}
+
+template<int NumTx, int NumRx>
+static void runLinkEnergy(const char *name, const VmerSolver& solver, const std::vector<int>& hosts, const std::vector<int>& second, double minTime)
+{
+    long n = hosts.size();
+    run(name, solver.getNumHosts(), n, minTime, [&]() {
+        double sum = 0;
+        for (long k = 0; k < n; ++k)
+            sum += solver.linkEnergyPerBit<NumTx, NumRx>(hosts[k], solver.getParentId(hosts[k]), second[k]);
+        sink = sum;
+    });
+}
+
+static void benchmark(int numHosts, double minTime)
+{
+    const double maxRange = 200;
+    const double gamma = 0.1;
+    Topology topo;
+    placeHosts(topo, numHosts, maxRange);
+    RadioModel radioModel;
+    VmerSolver solver(topo.graph, radioModel, maxRange, 0, gamma);
+    solver.solve();
+
+    // the hosts the kernels are evaluated for: those in the tree, with a
+    // neighbor other than the parent to act as the second receiver t
+    std::vector<int> hosts, second;
+    for (int u = 0; u < numHosts; ++u)
+    {
+        int v = solver.getParentId(u);
+        if (v == -1)
+            continue;
+        int t = v;
+        for (int e = topo.graph.getEdgeBegin(u); e < topo.graph.getEdgeEnd(u) && t == v; ++e)
+            t = topo.graph.getNeighborId(e);
+        hosts.push_back(u);
+        second.push_back(t);
+    }
+    long n = hosts.size();
+
+    static const struct { const char *name; int numTx, numRx; } modes[] = {
+        {"energy SISO", 1, 1}, {"energy SIMO", 1, 2}, {"energy MISO", 2, 1}, {"energy MIMO", 2, 2}
+    };
+    for (auto& mode : modes)
+    {
+        run(mode.name, numHosts, n, minTime, [&]() {
+            double sum = 0;
+            for (long k = 0; k < n; ++k)
+                sum += solver.calculateEnergyConsumptionPerBit(hosts[k], solver.getParentId(hosts[k]), second[k], mode.numTx, mode.numRx);
+            sink = sum;
+        });
+    }
+
+    // the same links with the mode fixed at compile time, as the getters
+    // call them
+    runLinkEnergy<1, 1>("static SISO", solver, hosts, second, minTime);
+    runLinkEnergy<1, 2>("static SIMO", solver, hosts, second, minTime);
+    runLinkEnergy<2, 1>("static MISO", solver, hosts, second, minTime);
+    runLinkEnergy<2, 2>("static MIMO", solver, hosts, second, minTime);
+
+    // the same links through the memo table, which the first pass fills;
+    // w is the solver's partner, as in Host
+    EnergyTable table;
+    table.reset(topo.graph, radioModel);
+    static const char *tableNames[] = {"table SISO", "table SIMO", "table MISO", "table MIMO"};
+    for (int m = 0; m < 4; ++m)
+    {
+        run(tableNames[m], numHosts, n, minTime, [&]() {
+            double sum = 0;
+            for (long k = 0; k < n; ++k)
+                sum += table.energyPerBit(modes[m].numTx, modes[m].numRx, hosts[k], solver.getPartnerId(hosts[k]), solver.getParentId(hosts[k]), second[k]);
+            sink = sum;
+        });
+    }
+
+    typedef double (VmerSolver::*PathEnergy)(int, double) const;
+    static const struct { const char *name; PathEnergy path; } paths[] = {
+        {"path 1", &VmerSolver::getPath_1_Energy}, {"path 2", &VmerSolver::getPath_2_Energy},
+        {"path 3", &VmerSolver::getPath_3_Energy}, {"path 4", &VmerSolver::getPath_4_Energy},
+        {"path 5", &VmerSolver::getPath_5_Energy}, {"path 6", &VmerSolver::getPath_6_Energy},
+        {"path 7", &VmerSolver::getPath_7_Energy}, {"path 8", &VmerSolver::getPath_8_Energy}
+    };
+    for (auto& path : paths)
+    {
+        run(path.name, numHosts, n, minTime, [&]() {
+            double sum = 0;
+            for (long k = 0; k < n; ++k)
+                sum += (solver.*path.path)(hosts[k], 1e-6);
+            sink = sum;
+        });
+    }
+
+    // the pairing loop visits every child of every host once per pass;
+    // one op is one host, paired and unpaired variant alternating
+    run("dct pairing", numHosts, n, minTime, [&]() {
+        double sum = 0;
+        for (long k = 0; k < n; ++k)
+        {
+            double weight;
+            sum += solver.choosePartner(hosts[k], k & 1, second[k], weight);
+        }
+        sink = sum;
+    });
+
+    // one op is one host in a data-gathering round over the MTD links,
+    // with a random half of the hosts sensing
+    std::vector<int> parent(numHosts);
+    std::vector<double> energyMTD(numHosts);
+    for (int u = 0; u < numHosts; ++u)
+    {
+        parent[u] = solver.getParentId(u);
+        energyMTD[u] = solver.getReportEnergyMTD(u);
+    }
+    DataGathering::Parameters params;
+    params.reportProbability = 0.5;
+    DataGathering gathering(parent, energyMTD, 0, params, 1);
+    run("gathering round", numHosts, numHosts, minTime, [&]() {
+        gathering.runRound();
+    });
+}
+
+/**
+ * Applies numEpochs topology changes incrementally and compares each with
+ * a fresh solve; returns the number of epochs that differ.
+ */
+static int checkEpochs(int numHosts, int numEpochs, bool treeScoped)
+{
+    const double maxRange = 200;
+    const double gamma = 0.1;
+    const int failuresPerEpoch = 1, movesPerEpoch = 5;
+    const double moveDistance = 10;
+    Topology topo;
+    placeHosts(topo, numHosts, maxRange);
+    RadioModel radioModel;
+    VmerSolver solver(topo.graph, radioModel, maxRange, 0, gamma);
+    solver.setTreeScopedRouteDiscovery(treeScoped);
+    solver.solve();
+
+    std::mt19937 rng(numHosts + 1);
+    std::vector<bool> alive(numHosts, true);
+    std::vector<int> candidates, updated, changed;
+    for (int i = 1; i < numHosts; ++i)
+        candidates.push_back(i);
+    double updateTime = 0, solveTime = 0;
+    int mismatches = 0, epoch = 0;
+    for (; epoch < numEpochs && !candidates.empty(); ++epoch)
+    {
+        updated.clear();
+        for (int k = 0; k < failuresPerEpoch && !candidates.empty(); ++k)
+        {
+            int c = std::uniform_int_distribution<int>(0, candidates.size() - 1)(rng);
+            updated.push_back(candidates[c]);
+            alive[candidates[c]] = false;
+            candidates[c] = candidates.back();
+            candidates.pop_back();
+        }
+        for (int k = 0; k < movesPerEpoch && !candidates.empty(); ++k)
+        {
+            int i = candidates[std::uniform_int_distribution<int>(0, candidates.size() - 1)(rng)];
+            double angle = std::uniform_real_distribution<double>(0, 2 * M_PI)(rng);
+            topo.x[i] += moveDistance * std::cos(angle);
+            topo.y[i] += moveDistance * std::sin(angle);
+            updated.push_back(i);
+        }
+        std::sort(updated.begin(), updated.end());
+        updated.erase(std::unique(updated.begin(), updated.end()), updated.end());
+
+        auto start = std::chrono::steady_clock::now();
+        topo.grid.update(updated, &alive);
+        changed.clear();
+        topo.graph.update(updated, topo.x, topo.y, alive, topo.grid, maxRange, changed);
+        solver.update(updated, changed);
+        auto middle = std::chrono::steady_clock::now();
+        SpatialGrid freshGrid;
+        NeighborGraph freshGraph;
+        freshGrid.build(topo.x, topo.y, maxRange, &alive);
+        freshGraph.build(topo.x, topo.y, freshGrid, maxRange);
+        VmerSolver fresh(freshGraph, radioModel, maxRange, 0, gamma);
+        fresh.setTreeScopedRouteDiscovery(treeScoped);
+        fresh.solve();
+        auto end = std::chrono::steady_clock::now();
+        updateTime += std::chrono::duration<double>(middle - start).count();
+        solveTime += std::chrono::duration<double>(end - middle).count();
+
+        bool same = solver.getTotalEnergy() == fresh.getTotalEnergy() && solver.getTotalEnergyMTD() == fresh.getTotalEnergyMTD();
+        for (int i = 0; i < numHosts && same; ++i)
+        {
+            same = solver.getParentId(i) == fresh.getParentId(i) && solver.getPartnerId(i) == fresh.getPartnerId(i)
+                    && solver.getTp1(i) == fresh.getTp1(i) && solver.getTp2(i) == fresh.getTp2(i);
+        }
+        if (!same)
+            mismatches++;
+    }
+    printf("%-24s %8d %8d %12.3f %12.3f %10d\n", treeScoped ? "epochs (tree scope)" : "epochs", numHosts, epoch,
+            updateTime * 1e3 / epoch, solveTime * 1e3 / epoch, mismatches);
+    return mismatches;
+}
+
+int main(int argc, char **argv)
+{
+    double minTime = 0.2;
+    int numEpochs = 0;
+    std::vector<int> sizes;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "-t" && i + 1 < argc)
+            minTime = atof(argv[++i]);
+        else if (arg == "-e" && i + 1 < argc)
+            numEpochs = atoi(argv[++i]);
+        else if (atoi(argv[i]) > 0)
+            sizes.push_back(atoi(argv[i]));
+        else
+        {
+            fprintf(stderr, "Usage: %s [-t seconds per benchmark] [-e epochs] [hosts...]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (sizes.empty())
+        sizes = {100, 1000, 10000};
+    for (int numHosts : sizes)
+        if (checkBatchKernels(numHosts) > 0)
+            return 1;
+
+    if (numEpochs > 0)
+    {
+        printf("%-24s %8s %8s %12s %12s %10s\n", "check", "hosts", "epochs", "update ms", "solve ms", "different");
+        int mismatches = 0;
+        for (int numHosts : sizes)
+            for (bool treeScoped : {false, true})
+                mismatches += checkEpochs(numHosts, numEpochs, treeScoped);
+        return mismatches == 0 ? 0 : 1;
+    }
+
+    printf("%-24s %8s %12s %12s\n", "benchmark", "hosts", "ns/op", "allocs/op");
+    for (int numHosts : sizes)
+        benchmark(numHosts, minTime);
+    return 0;
+}